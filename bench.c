@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "golsh.h"
+
+ // Runs every engine on a fixed set of boards without any display or
+ // throttling, and appends one JSON line per run to a results file so runs
+ // from different commits can be compared.  Each run happens in its own
+ // process so that its peak RSS isn't polluted by earlier runs.
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+int width, height, window_width, window_height, fullscreen, paused, trails;
+int wrap = 1;
+float fps;
+int seed = 1;
+
+const char* bench_engines = "tiled,sparse,hashlife,infinite,blocked";
+const char* bench_sizes = "512,2048,8192";
+const char* bench_patterns = "patterns/rpentomino.rle,patterns/acorn.rle,patterns/gosper.rle";
+const char* out_filename = "bench.jsonl";
+const char* compare_filename = NULL;
+long long cell_budget = 1LL << 31;  // Cell updates per run
+long long fixed_gens = 0;
+int nthreads = 1;
+
+typedef struct Result {
+    char engine [32];
+    int size;
+    char input [256];
+    long long gens;
+    double secs;
+    long long population;
+} Result;
+
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+ // Calls f on each comma-separated item in list.
+void each_item (const char* list, void (*f) (const char* item, void* arg), void* arg) {
+    char item [256];
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        if (len >= sizeof item) len = sizeof item - 1;
+        memcpy(item, list, len);
+        item[len] = 0;
+        if (len) f(item, arg);
+        list += len;
+        if (*list == ',') list++;
+    }
+}
+
+void run_case (const char* engine_name, int size, const char* input, FILE* out) {
+    int fds [2];
+    if (pipe(fds)) {
+        perror("pipe");
+        exit(1);
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        start_threads(nthreads);
+        select_engine(engine_name);
+        check_rule_engine();
+        Result r;
+        memset(&r, 0, sizeof r);
+        snprintf(r.engine, sizeof r.engine, "%s", engine_name);
+        snprintf(r.input, sizeof r.input, "%s", input);
+        r.size = size;
+        r.gens = fixed_gens ? fixed_gens : cell_budget / ((long long)size * size);
+        if (r.gens < 1) r.gens = 1;
+        Board* b = board_new(size, size, wrap);
+        if (0==strncmp(input, "seed=", 5)) {
+            seed = atoi(input + 5);
+            board_randomize(b);
+        }
+        else {
+            read_rle(b, input, NULL);
+        }
+        double start = now();
+        engine->step(b, r.gens);
+        r.secs = now() - start;
+        r.population = engine->population(b);
+        if (write(fds[1], &r, sizeof r) != sizeof r) _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    Result r;
+    ssize_t got = read(fds[0], &r, sizeof r);
+    close(fds[0]);
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    if (got != sizeof r || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        fprintf(stderr, "Benchmark %s %d %s failed.\n", engine_name, size, input);
+        return;
+    }
+    double cells = (double)size * size * r.gens;
+    double ns_per_gen = r.secs * 1e9 / r.gens;
+    printf("%-9s %6d  %-28s %8lld gens %10.3f Gcells/s %14.0f ns/gen %8ld KB\n",
+        r.engine, r.size, r.input, r.gens, cells / r.secs / 1e9, ns_per_gen, ru.ru_maxrss
+    );
+    fprintf(out,
+        "{\"commit\": \"%s\", \"engine\": \"%s\", \"kernel\": \"%s\", \"rule\": \"%s\", \"threads\": %d, "
+        "\"size\": %d, \"input\": \"%s\", \"gens\": %lld, \"seconds\": %.6f, "
+        "\"cells_per_sec\": %.0f, \"ns_per_gen\": %.0f, \"peak_rss_kb\": %ld, "
+        "\"population\": %lld}\n",
+        BENCH_COMMIT, r.engine, kernel->name, rule.name, nthreads, r.size, r.input, r.gens, r.secs,
+        cells / r.secs, ns_per_gen, ru.ru_maxrss, r.population
+    );
+    fflush(out);
+}
+
+typedef struct Sweep {
+    const char* engine;
+    int size;
+    FILE* out;
+} Sweep;
+
+void sweep_input (const char* input, void* arg) {
+    Sweep* s = arg;
+    run_case(s->engine, s->size, input, s->out);
+}
+void sweep_size (const char* size, void* arg) {
+    Sweep* s = arg;
+    char seed_input [32];
+    s->size = atoi(size);
+    snprintf(seed_input, sizeof seed_input, "seed=%d", seed);
+    sweep_input(seed_input, s);
+    each_item(bench_patterns, sweep_input, s);
+}
+void sweep_engine (const char* engine_name, void* arg) {
+    Sweep* s = arg;
+    s->engine = engine_name;
+    each_item(bench_sizes, sweep_size, s);
+}
+
+ // Prints how each run written to the results file from start on compares
+ // to the latest run of the same case in another results file.
+void compare (const char* old_filename, const char* new_filename, long start) {
+    FILE* o = fopen(old_filename, "r");
+    FILE* n = fopen(new_filename, "r");
+    if (!o || !n) {
+        fprintf(stderr, "Can't open results to compare.\n");
+        exit(1);
+    }
+    fseek(n, start, SEEK_SET);
+    char line [1024];
+    int regressions = 0;
+    while (fgets(line, sizeof line, n)) {
+        char engine_name [32], input [256];
+        int size;
+        double speed;
+        char* p = strstr(line, "\"engine\": \"");
+        char* q = strstr(line, "\"size\": ");
+        if (!p || !q || sscanf(p, "\"engine\": \"%31[^\"]", engine_name) != 1
+         || sscanf(q, "\"size\": %d, \"input\": \"%255[^\"]", &size, input) != 2
+         || !(p = strstr(line, "\"cells_per_sec\": ")) || sscanf(p, "\"cells_per_sec\": %lf", &speed) != 1)
+            continue;
+        double old_speed = 0;
+        char oline [1024];
+        rewind(o);
+        while (fgets(oline, sizeof oline, o)) {
+            char oengine [32], oinput [256];
+            int osize;
+            double ospeed;
+            char* op = strstr(oline, "\"engine\": \"");
+            char* oq = strstr(oline, "\"size\": ");
+            if (op && oq && sscanf(op, "\"engine\": \"%31[^\"]", oengine) == 1
+             && sscanf(oq, "\"size\": %d, \"input\": \"%255[^\"]", &osize, oinput) == 2
+             && (op = strstr(oline, "\"cells_per_sec\": ")) && sscanf(op, "\"cells_per_sec\": %lf", &ospeed) == 1
+             && 0==strcmp(oengine, engine_name) && osize == size && 0==strcmp(oinput, input))
+                old_speed = ospeed;
+        }
+        if (old_speed > 0) {
+            double change = (speed / old_speed - 1) * 100;
+            printf("%-9s %6d  %-28s %+7.1f%%%s\n", engine_name, size, input, change,
+                change < -10 ? "  REGRESSION" : ""
+            );
+            if (change < -10) regressions++;
+        }
+    }
+    fclose(o);
+    fclose(n);
+    if (regressions) exit(2);
+}
+
+int opt_s (char* arg, size_t len, const char* prefix, const char** var) {
+    if (0==strncmp(arg, prefix, len)) {
+        *var = arg+len;
+        return 1;
+    }
+    return 0;
+}
+int opt_i (char* arg, size_t len, const char* prefix, int* var) {
+    if (0==strncmp(arg, prefix, len)) {
+        sscanf(arg+len, "%d", var);
+        return 1;
+    }
+    return 0;
+}
+int opt_ll (char* arg, size_t len, const char* prefix, long long* var) {
+    if (0==strncmp(arg, prefix, len)) {
+        sscanf(arg+len, "%lld", var);
+        return 1;
+    }
+    return 0;
+}
+
+int main (int argc, char** argv) {
+    const char* kernel_name = NULL;
+    const char* rule_name = NULL;
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (opt_s(argv[i], 9, "-engines=", &bench_engines)) continue;
+        if (opt_s(argv[i], 7, "-sizes=", &bench_sizes)) continue;
+        if (opt_s(argv[i], 10, "-patterns=", &bench_patterns)) continue;
+        if (opt_s(argv[i], 5, "-out=", &out_filename)) continue;
+        if (opt_s(argv[i], 9, "-compare=", &compare_filename)) continue;
+        if (opt_s(argv[i], 8, "-kernel=", &kernel_name)) continue;
+        if (opt_s(argv[i], 6, "-rule=", &rule_name)) continue;
+        if (opt_ll(argv[i], 8, "-budget=", &cell_budget)) continue;
+        if (opt_ll(argv[i], 6, "-gens=", &fixed_gens)) continue;
+        if (opt_i(argv[i], 9, "-threads=", &nthreads)) continue;
+        if (opt_i(argv[i], 6, "-seed=", &seed)) continue;
+        if (0==strcmp(argv[i], "-no-wrap")) {
+            wrap = 0;
+            continue;
+        }
+        fprintf(stderr, "Unrecognized option: %s\n", argv[i]);
+        exit(1);
+    }
+    select_kernel(kernel_name);
+    if (rule_name) {
+        select_rule(rule_name);
+        rule_fixed = 1;
+    }
+    FILE* out = fopen(out_filename, "a");
+    if (!out) {
+        perror(out_filename);
+        exit(1);
+    }
+    fseek(out, 0, SEEK_END);
+    long start = ftell(out);
+    Sweep s = {NULL, 0, out};
+    each_item(bench_engines, sweep_engine, &s);
+    fclose(out);
+    if (compare_filename) compare(compare_filename, out_filename, start);
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // The blocked engine steps the board block_gens generations at a time
+ // tile by tile.  Each tile is copied out with block_gens rows and at least
+ // as many cells of halo on every side into a buffer small enough to stay
+ // in cache, stepped there that many times, and only the middle, which
+ // nothing outside the halo can have reached yet, is written back.  So the
+ // board goes through memory once per block_gens generations rather than
+ // once per generation, for a little work redone in the halos.
+ //
+ // The buffer lays the board's cells out unbroken, wrapping around the
+ // edges when the board does, so the kernels' spans run over it as over
+ // any row.  The outermost rows and words are never stepped and go stale,
+ // and the staleness creeps inward a cell each generation, which is what
+ // the halo is for.  Without wrapping, cells off the board are cleared
+ // after every generation, since they must stay dead.
+ //
+ // Under -period each block also adds up how every generation it steps
+ // through moves the hash, from its own rows, which are all still good,
+ // so the generations between swaps are hashed without a board for them.
+#define BLOCK_ROWS 256
+#define BLOCK_WORDS 256
+
+long long block_gens = 16;
+
+typedef struct BlockJob {
+    int gens;
+    int halo_words;  // Each side, one more than the cells need, for the stale edge word
+    int hashing;
+    uint64_t deltas [64];  // How each generation moved the hash, when hashing
+} BlockJob;
+
+ // Returns the 64 cells from x along row y, wrapping or dead past the edges.
+static uint64_t fetch_word (const Board* b, int y, int64_t x) {
+    if (y < 0 || y >= b->height) {
+        if (!b->wrap) return 0;
+        y = ((y % b->height) + b->height) % b->height;
+    }
+    const uint64_t* row = &b->cells[(size_t)y * b->words];
+    if (x >= 0 && x % 64 == 0 && x + 64 <= b->width) return row[x / 64];
+    uint64_t w = 0;
+    int n = 0;
+    while (n < 64) {
+        int64_t cx = x + n;
+        if (cx < 0 || cx >= b->width) {
+            if (!b->wrap) {
+                n++;
+                continue;
+            }
+            cx = ((cx % b->width) + b->width) % b->width;
+        }
+         // As many cells as are left in this word and on the board.
+        int bit = cx % 64;
+        int take = 64 - n < 64 - bit ? 64 - n : 64 - bit;
+        if (take > b->width - cx) take = b->width - cx;
+        uint64_t bits = row[cx / 64] >> bit;
+        if (take < 64) bits &= ((uint64_t)1 << take) - 1;
+        w |= bits << n;
+        n += take;
+    }
+    return w;
+}
+
+static uint64_t fetch_mask (const Board* b, int64_t x) {
+    if (x >= 0 && x + 64 <= b->width) return ~(uint64_t)0;
+    uint64_t m = 0;
+    int n;
+    for (n = 0; n < 64; n++) {
+        if (x + n >= 0 && x + n < b->width) m |= (uint64_t)1 << n;
+    }
+    return m;
+}
+
+ // Adds to the job's delta for generation g how the rows of the block
+ // moved the hash from in to out.  On a wrapping board a partial last word
+ // carries on with cells from the left edge, which the hash leaves out.
+static void hash_rows (const Board* b, BlockJob* job, int g, const uint64_t* in, const uint64_t* out, int band, int rows, int j0, int words) {
+    int k = job->gens, h = job->halo_words;
+    int across = BLOCK_WORDS + 2 * h;
+    int whole = j0 + words < b->words || b->width % 64 == 0 ? words : words - 1;
+    uint64_t delta = 0;
+    int y;
+    for (y = k; y < k + rows; y++) {
+        const uint64_t* was = &in[y * across + h];
+        const uint64_t* now = &out[y * across + h];
+        uint64_t at = (uint64_t)(band + y - k) * b->words + j0;
+        delta += hash_delta(was, now, at, whole);
+        if (whole < words) {
+            uint64_t w = was[whole] & b->tail, n = now[whole] & b->tail;
+            delta += hash_delta(&w, &n, at + whole, 1);
+        }
+    }
+    if (delta) __atomic_fetch_add(&job->deltas[g - 1], delta, __ATOMIC_RELAXED);
+}
+
+static void step_blocks (Board* b, int y0, int y1, void* arg) {
+    BlockJob* job = arg;
+    int k = job->gens, h = job->halo_words;
+    int across = BLOCK_WORDS + 2 * h;
+    int down = BLOCK_ROWS + 2 * k;
+    uint64_t* buf [2] = {alloc_words((size_t)across * down), alloc_words((size_t)across * down)};
+    uint64_t* mask = alloc_words(across);
+    int band, j0, y, j, g;
+    for (band = y0; band < y1; band += BLOCK_ROWS) {
+        int rows = band + BLOCK_ROWS < y1 ? BLOCK_ROWS : y1 - band;
+        int ld = rows + 2 * k;  // Rows of buffer in use
+        for (j0 = 0; j0 < b->words; j0 += BLOCK_WORDS) {
+            int words = j0 + BLOCK_WORDS < b->words ? BLOCK_WORDS : b->words - j0;
+            int la = words + 2 * h;
+            int64_t x0 = ((int64_t)j0 - h) * 64;
+             // Rows whose span lies within the board's words, short of a
+             // partial last one, are copied straight.
+            int whole = j0 - h >= 0 && (x0 + (int64_t)la * 64 <= b->width);
+            for (y = 0; y < ld; y++) {
+                int by = band - k + y;
+                if (whole && by >= 0 && by < b->height) {
+                    memcpy(&buf[0][y * across], &b->cells[(size_t)by * b->words + j0 - h], la * sizeof(uint64_t));
+                    continue;
+                }
+                for (j = 0; j < la; j++) buf[0][y * across + j] = fetch_word(b, by, x0 + (int64_t)j * 64);
+            }
+            if (!b->wrap) {
+                for (j = 0; j < la; j++) mask[j] = fetch_mask(b, x0 + (int64_t)j * 64);
+            }
+            for (g = 1; g <= k; g++) {
+                const uint64_t* in = buf[(g - 1) & 1];
+                uint64_t* out = buf[g & 1];
+                 // Rows nearer the ends than g are stale by now anyway.
+                for (y = g; y < ld - g; y++) {
+                    uint64_t* o = &out[y * across];
+                    kernel->spans[rule.kernel](&in[(y + 1) * across], &in[y * across], &in[(y - 1) * across], o, 1, la - 1);
+                    if (b->wrap) continue;
+                    int by = band - k + y;
+                    if (by < 0 || by >= b->height) memset(o, 0, la * sizeof(uint64_t));
+                    else {
+                        for (j = 1; j < la - 1; j++) o[j] &= mask[j];
+                    }
+                }
+                if (job->hashing) hash_rows(b, job, g, in, out, band, rows, j0, words);
+            }
+            const uint64_t* done = buf[k & 1];
+            for (y = 0; y < rows; y++) {
+                uint64_t* row = &b->next[(size_t)(band + y) * b->words];
+                memcpy(&row[j0], &done[(y + k) * across + h], words * sizeof(uint64_t));
+                if (j0 + words == b->words) row[b->words - 1] &= b->tail;
+            }
+        }
+    }
+    free(buf[0]);
+    free(buf[1]);
+    free(mask);
+}
+
+void blocked_step (Board* b, uint64_t gens) {
+    int most = block_gens < 1 ? 1 : block_gens > 64 ? 64 : block_gens;
+    while (gens) {
+        BlockJob job;
+        job.gens = gens < (uint64_t)most ? gens : most;
+        job.halo_words = 1 + (job.gens + 63) / 64;
+        job.hashing = period_on;
+        if (job.hashing) {
+            period_update(b);
+            memset(job.deltas, 0, sizeof job.deltas);
+        }
+        threaded_rows(b, step_blocks, &job);
+        if (job.hashing) period_between(b, job.deltas, job.gens);
+        b->generation += job.gens - 1;
+        board_swap(b);
+        gens -= job.gens;
+    }
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Edits from the mouse pile up here, as a mask of the cells touched and
+ // the values to give them laid out like the board's words, until the
+ // display applies them all at once each frame.  The rows and columns
+ // touched are tracked so that applying and uploading cover only those.
+
+uint64_t* brush_mask;
+uint64_t* brush_value;
+int brush_width;
+int brush_height;
+int brush_words;
+int dirty_x0, dirty_y0, dirty_x1, dirty_y1;  // Inclusive, empty if x0 > x1
+
+static void brush_fit (const Board* b) {
+    if (b->width == brush_width && b->height == brush_height) return;
+    free(brush_mask);
+    free(brush_value);
+    brush_width = b->width;
+    brush_height = b->height;
+    brush_words = b->words;
+    brush_mask = alloc_words((size_t)brush_words * brush_height);
+    brush_value = alloc_words((size_t)brush_words * brush_height);
+    dirty_x0 = dirty_y0 = 0;
+    dirty_x1 = dirty_y1 = -1;
+}
+
+ // Sets the n cells (up to 64) from x in row y to the low bits of bits,
+ // clipped to the board.
+static void brush_span (int x, int y, uint64_t bits, int n) {
+    if (y < 0 || y >= brush_height || x >= brush_width || x + n <= 0) return;
+    if (x < 0) {
+        bits >>= -x;
+        n += x;
+        x = 0;
+    }
+    if (x + n > brush_width) n = brush_width - x;
+    uint64_t keep = n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+    bits &= keep;
+    uint64_t* mask = &brush_mask[(size_t)y * brush_words];
+    uint64_t* value = &brush_value[(size_t)y * brush_words];
+    int j = x / 64, bit = x % 64;
+    mask[j] |= keep << bit;
+    value[j] = (value[j] & ~(keep << bit)) | bits << bit;
+    if (bit && bit + n > 64) {
+        mask[j + 1] |= keep >> (64 - bit);
+        value[j + 1] = (value[j + 1] & ~(keep >> (64 - bit))) | bits >> (64 - bit);
+    }
+    if (dirty_x0 > dirty_x1) {
+        dirty_x0 = x;
+        dirty_x1 = x + n - 1;
+        dirty_y0 = dirty_y1 = y;
+        return;
+    }
+    if (dirty_x0 > x) dirty_x0 = x;
+    if (dirty_x1 < x + n - 1) dirty_x1 = x + n - 1;
+    if (dirty_y0 > y) dirty_y0 = y;
+    if (dirty_y1 < y) dirty_y1 = y;
+}
+
+ // Draws a line of cells from x0, y0 to x1, y1, so that a fast drag leaves
+ // no gaps between the positions the mouse was sampled at.
+void brush_line (const Board* b, int x0, int y0, int x1, int y1, int val) {
+    brush_fit(b);
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        brush_span(x0, y0, val ? 1 : 0, 1);
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+ // Overwrites the cells under pattern with it, centered on x, y.
+void brush_stamp (const Board* b, const Board* pattern, int x, int y) {
+    brush_fit(b);
+    int left = x - pattern->width / 2;
+    int bottom = y - pattern->height / 2;
+    int py, j;
+    for (py = 0; py < pattern->height; py++) {
+        const uint64_t* row = &pattern->cells[(size_t)py * pattern->words];
+        for (j = 0; j < pattern->words; j++) {
+            int n = j == pattern->words - 1 ? pattern->width - j * 64 : 64;
+            brush_span(left + j * 64, bottom + py, row[j], n);
+        }
+    }
+}
+
+int brush_dirty () {
+    return brush_mask && dirty_x0 <= dirty_x1;
+}
+
+ // Applies what's been drawn since the last call to b, returning 0 if
+ // nothing was, or 1 with the rectangle that changed.
+int brush_apply (Board* b, int* x0, int* y0, int* x1, int* y1) {
+    if (!brush_dirty()) return 0;
+    brush_fit(b);
+    int y, j;
+    for (y = dirty_y0; y <= dirty_y1; y++) {
+        uint64_t* mask = &brush_mask[(size_t)y * brush_words];
+        uint64_t* value = &brush_value[(size_t)y * brush_words];
+        uint64_t* row = &b->cells[(size_t)y * b->words];
+        for (j = dirty_x0 / 64; j <= dirty_x1 / 64; j++) {
+            if (!mask[j]) continue;
+            row[j] = (row[j] & ~mask[j]) | (value[j] & mask[j]);
+            int p;
+            for (p = 0; p < b->age_planes; p++) {
+                b->ages[((size_t)p * b->height + y) * b->words + j] &= ~mask[j];
+            }
+            mask[j] = 0;
+        }
+    }
+    *x0 = dirty_x0;
+    *y0 = dirty_y0;
+    *x1 = dirty_x1;
+    *y1 = dirty_y1;
+    dirty_x0 = dirty_y0 = 0;
+    dirty_x1 = dirty_y1 = -1;
+    b->edits++;
+    return 1;
+}
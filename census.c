@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // -census lists the objects on the board when a headless run ends, which
+ // with -stop-on-stable is once it has settled.  Objects are the groups of
+ // live cells no more than two apart, since many, like the carrier and the
+ // spaceships, aren't 8-connected.  Groups whose 8-connected pieces each
+ // run the same on their own, like two blocks side by side, are counted as
+ // those pieces.  They're found from runs of live cells read
+ // straight off the board's words: each thread takes a band of rows, finds
+ // its runs and joins those that touch into components with union-find,
+ // and the joins across bands and edges are made afterwards.  Each object
+ // is then cut out, and looked up by its exact cells among the shapes seen
+ // before.  Only new shapes are classified: the object is run on its own
+ // until it repeats, and named by its apgcode, the smallest extended
+ // Wechsler code over its phases and orientations with a prefix for still
+ // lifes (xs), oscillators (xp) and spaceships (xq), as apgsearch does.
+ // Ash is mostly a few kinds of small object, so after the first census
+ // nearly every object is a lookup.
+#define SHAPE_MAX 64  // Objects wider or taller than this are oversized
+#define CENSUS_MAX_PERIOD 256
+#define CENSUS_MAX_PIECES 16
+#define SPLIT -1  // The kind of groups counted as their pieces
+
+int census_on;
+
+typedef struct Shape {
+    int w;
+    int h;
+    uint64_t rows [SHAPE_MAX];  // Bit x of row y is the cell at x, y
+} Shape;
+
+typedef struct Kind {
+    char* code;
+    const char* name;  // NULL if it has no common name
+    uint64_t count;  // In the latest census
+} Kind;
+
+typedef struct Seen {
+    uint64_t hash;  // 0 for an empty slot
+    int kind;
+    Shape shape;
+} Seen;
+
+Kind* kinds;
+int nkinds;
+int kinds_cap;
+Seen* seen;
+size_t seen_cap;  // A power of 2
+size_t nseen;
+uint32_t census_birth, census_survive;  // The rule the kinds were classified under
+
+ // Runs of live cells, those of row y being row_first[y] up to
+ // row_first[y + 1], and the union-find forest over them.
+int* row_first;
+int* run_x0;
+int* run_x1;
+int* run_y;
+int* run_parent;
+int* run_order;
+int runs_cap;
+int rows_cap;
+
+static const struct {
+    const char* code;
+    const char* name;
+} life_names [] = {
+    {"xs4_33", "block"},
+    {"xs6_696", "beehive"},
+    {"xs7_2596", "loaf"},
+    {"xs5_253", "boat"},
+    {"xs6_356", "ship"},
+    {"xs4_252", "tub"},
+    {"xs8_6996", "pond"},
+    {"xs6_25a4", "barge"},
+    {"xs7_25ac", "long boat"},
+    {"xs8_69ic", "mango"},
+    {"xs6_bd", "snake"},
+    {"xs6_39c", "carrier"},
+    {"xs7_178c", "eater 1"},
+    {"xp2_7", "blinker"},
+    {"xp2_7e", "toad"},
+    {"xp2_318c", "beacon"},
+    {"xq4_153", "glider"},
+    {"xq4_6frc", "lightweight spaceship"},
+    {"xq4_27dee6", "middleweight spaceship"},
+    {"xq4_27deee6", "heavyweight spaceship"},
+};
+
+static uint64_t mix (uint64_t h, uint64_t w) {
+    h = (h ^ w) * 0xbf58476d1ce4e5b9ull;
+    return h ^ h >> 31;
+}
+
+static uint64_t shape_hash (const Shape* s) {
+    uint64_t h = mix((uint64_t)s->w << 32 | s->h, 0x9e3779b97f4a7c15ull);
+    int y;
+    for (y = 0; y < s->h; y++) h = mix(h, s->rows[y]);
+    return h ? h : 1;
+}
+
+static int shape_equal (const Shape* a, const Shape* b) {
+    return a->w == b->w && a->h == b->h && !memcmp(a->rows, b->rows, a->h * sizeof(uint64_t));
+}
+
+static uint64_t shape_population (const Shape* s) {
+    uint64_t n = 0;
+    int y;
+    for (y = 0; y < s->h; y++) n += __builtin_popcountll(s->rows[y]);
+    return n;
+}
+
+ // Cuts the live cells of h rows down to a shape, giving where its corner
+ // was.  There must be some.
+static void crop (const uint64_t* rows, int h, Shape* out, int* x0, int* y0) {
+    uint64_t any = 0;
+    int y;
+    for (y = 0; y < h; y++) any |= rows[y];
+    int first = 0, last = h - 1;
+    while (!rows[first]) first++;
+    while (!rows[last]) last--;
+    int xmin = __builtin_ctzll(any);
+    memset(out, 0, sizeof *out);
+    out->w = 64 - __builtin_clzll(any) - xmin;
+    out->h = last - first + 1;
+    for (y = first; y <= last; y++) out->rows[y - first] = rows[y] >> xmin;
+    *x0 = xmin;
+    *y0 = first;
+}
+
+ // Steps s on its own under the current rule, cropping the result and
+ // giving how far its corner moved.  Returns 0 if it died or got too big.
+static int step_shape (const Shape* s, Shape* out, int* dx, int* dy) {
+    if (s->w > SHAPE_MAX - 2 || s->h > SHAPE_MAX - 2) return 0;
+     // Row y of s goes in g[y + 2], a cell right, leaving a dead border.
+    uint64_t g [SHAPE_MAX + 4] = {0};
+    uint64_t next [SHAPE_MAX + 2];
+    uint64_t any = 0;
+    int y;
+    for (y = 0; y < s->h; y++) g[y + 2] = s->rows[y] << 1;
+    for (y = 0; y < s->h + 2; y++) {
+        uint64_t u = g[y + 2], m = g[y + 1], d = g[y];
+        next[y] = RULE_WORD(u << 1, u, u >> 1, m << 1, m, m >> 1, d << 1, d, d >> 1,
+            rule.birth_mask, rule.survive_mask
+        );
+        any |= next[y];
+    }
+    if (!any) return 0;
+    crop(next, s->h + 2, out, dx, dy);
+    *dx -= 1;
+    *dy -= 1;
+    return 1;
+}
+
+ // Cuts s into its 8-connected pieces, each left where it is in s,
+ // returning how many, or 0 if there are more than max.
+static int pieces (const Shape* s, uint64_t (*out) [SHAPE_MAX], int max) {
+    uint64_t left [SHAPE_MAX];
+    memcpy(left, s->rows, s->h * sizeof(uint64_t));
+    int n = 0, y;
+    for (;;) {
+        for (y = 0; y < s->h && !left[y]; y++);
+        if (y == s->h) return n;
+        if (n == max) return 0;
+        uint64_t* piece = out[n++];
+        memset(piece, 0, SHAPE_MAX * sizeof(uint64_t));
+        piece[y] = left[y] & -left[y];
+        int grew = 1;
+        while (grew) {
+            grew = 0;
+            for (y = 0; y < s->h; y++) {
+                uint64_t near = piece[y] | (y ? piece[y - 1] : 0) | (y + 1 < s->h ? piece[y + 1] : 0);
+                near = (near | near << 1 | near >> 1) & left[y];
+                if (near != piece[y]) {
+                    piece[y] = near;
+                    grew = 1;
+                }
+            }
+        }
+        for (y = 0; y < s->h; y++) left[y] &= ~piece[y];
+    }
+}
+
+ // Steps h rows in place, returning 0 if anything reached the edges.
+static int step_frame (uint64_t* rows, int h) {
+    uint64_t next [SHAPE_MAX];
+    int y;
+    for (y = 0; y < h; y++) {
+        uint64_t u = y + 1 < h ? rows[y + 1] : 0, m = rows[y], d = y ? rows[y - 1] : 0;
+        next[y] = RULE_WORD(u << 1, u, u >> 1, m << 1, m, m >> 1, d << 1, d, d >> 1,
+            rule.birth_mask, rule.survive_mask
+        );
+        if (next[y] & 0x8000000000000001ull) return 0;
+    }
+    if (next[0] || next[h - 1]) return 0;
+    memcpy(rows, next, h * sizeof(uint64_t));
+    return 1;
+}
+
+ // Whether the n pieces of s, which comes back after period generations
+ // without moving, each run on their own make up s all the way round and
+ // come back too, so s is only things side by side, like two blocks or the
+ // four blinkers of a traffic light.
+#define FRAME_MARGIN 4
+static int separable (const Shape* s, int period, uint64_t (*parts) [SHAPE_MAX], int n) {
+    if (s->w > 64 - 2 * FRAME_MARGIN || s->h > SHAPE_MAX - 2 * FRAME_MARGIN) return 0;
+    int h = s->h + 2 * FRAME_MARGIN;
+     // Each piece's frame, then the whole's.
+    uint64_t* frames = calloc((size_t)(n + 1) * 2 * h, sizeof(uint64_t));
+    uint64_t* start = &frames[(size_t)(n + 1) * h];
+    int k, y, g, ok = 1;
+    for (k = 0; k <= n; k++) {
+        for (y = 0; y < s->h; y++) {
+            frames[k * h + y + FRAME_MARGIN] = (k < n ? parts[k][y] : s->rows[y]) << FRAME_MARGIN;
+        }
+    }
+    memcpy(start, frames, (size_t)(n + 1) * h * sizeof(uint64_t));
+    for (g = 0; g < period && ok; g++) {
+        for (k = 0; k <= n && ok; k++) ok = step_frame(&frames[k * h], h);
+        for (y = 0; y < h && ok; y++) {
+            uint64_t all = 0;
+            for (k = 0; k < n; k++) all |= frames[k * h + y];
+            ok = all == frames[n * h + y];
+        }
+    }
+    if (ok) ok = !memcmp(frames, start, (size_t)n * h * sizeof(uint64_t));
+    free(frames);
+    return ok;
+}
+
+ // One of the 8 symmetries of the square: t & 1 flips x, t & 2 flips y and
+ // t & 4 swaps them, after the flips.
+static void orient (const Shape* s, int t, Shape* out) {
+    memset(out, 0, sizeof *out);
+    out->w = t & 4 ? s->h : s->w;
+    out->h = t & 4 ? s->w : s->h;
+    int x, y;
+    for (y = 0; y < s->h; y++) {
+        for (x = 0; x < s->w; x++) {
+            if (!(s->rows[y] >> x & 1)) continue;
+            int tx = t & 1 ? s->w - 1 - x : x;
+            int ty = t & 2 ? s->h - 1 - y : y;
+            if (t & 4) out->rows[tx] |= (uint64_t)1 << ty;
+            else out->rows[ty] |= (uint64_t)1 << tx;
+        }
+    }
+}
+
+ // The extended Wechsler format: strips of 5 rows separated by z, each
+ // column a digit of base 32 with bit r for row r of the strip, and runs of
+ // blank columns written 0, w, x or y followed by the count less 4.
+static void wechsler (const Shape* s, char* out) {
+    static const char digits [] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char* p = out;
+    int strip, x, r;
+    for (strip = 0; strip * 5 < s->h; strip++) {
+        if (strip) *p++ = 'z';
+        int blanks = 0;
+        for (x = 0; x < s->w; x++) {
+            int v = 0;
+            for (r = 0; r < 5 && strip * 5 + r < s->h; r++) v |= (s->rows[strip * 5 + r] >> x & 1) << r;
+            if (!v) {
+                blanks++;
+                continue;
+            }
+            while (blanks) {
+                int n = blanks < 39 ? blanks : 39;
+                if (n == 1) *p++ = '0';
+                else if (n == 2) *p++ = 'w';
+                else if (n == 3) *p++ = 'x';
+                else {
+                    *p++ = 'y';
+                    *p++ = digits[n - 4];
+                }
+                blanks -= n;
+            }
+            *p++ = digits[v];
+        }
+    }
+    *p = 0;
+}
+
+ // Shorter codes come first, then lower ones.
+static int code_before (const char* a, const char* b) {
+    size_t la = strlen(a), lb = strlen(b);
+    return la != lb ? la < lb : strcmp(a, b) < 0;
+}
+
+static int find_kind (const char* code) {
+    int i;
+    for (i = 0; i < nkinds; i++) {
+        if (!strcmp(kinds[i].code, code)) return i;
+    }
+    if (nkinds == kinds_cap) {
+        kinds_cap = kinds_cap ? kinds_cap * 2 : 64;
+        kinds = realloc(kinds, kinds_cap * sizeof(Kind));
+    }
+    Kind* k = &kinds[nkinds];
+    k->code = strdup(code);
+    k->name = NULL;
+    k->count = 0;
+    if (rule.kernel == RULE_LIFE) {
+        for (i = 0; i < (int)(sizeof life_names / sizeof life_names[0]); i++) {
+            if (!strcmp(life_names[i].code, code)) k->name = life_names[i].name;
+        }
+    }
+    return nkinds++;
+}
+
+ // Runs the shape until it comes back and names what it is.
+static int classify (const Shape* s) {
+    Shape* phases = malloc(CENSUS_MAX_PERIOD * sizeof(Shape));
+    phases[0] = *s;
+    int period = 0, ox = 0, oy = 0, g;
+    for (g = 1; g <= CENSUS_MAX_PERIOD; g++) {
+        Shape next;
+        int dx, dy;
+        if (!step_shape(&phases[g - 1], &next, &dx, &dy)) break;
+        ox += dx;
+        oy += dy;
+        if (shape_equal(&next, s)) {
+            period = g;
+            break;
+        }
+        if (g < CENSUS_MAX_PERIOD) phases[g] = next;
+    }
+    if (!period) {
+        free(phases);
+        return find_kind("unresolved");
+    }
+    char best [SHAPE_MAX * 26];
+    char code [SHAPE_MAX * 26];
+    best[0] = 0;
+    int t;
+    for (g = 0; g < period; g++) {
+        for (t = 0; t < 8; t++) {
+            Shape o;
+            orient(&phases[g], t, &o);
+            wechsler(&o, code);
+            if (!best[0] || code_before(code, best)) strcpy(best, code);
+        }
+    }
+    free(phases);
+     // Groups side by side are counted as their pieces.
+    if (!ox && !oy) {
+        uint64_t parts [CENSUS_MAX_PIECES][SHAPE_MAX];
+        int n = pieces(s, parts, CENSUS_MAX_PIECES);
+        if (n > 1 && separable(s, period, parts, n)) return SPLIT;
+    }
+    char prefix [32];
+    if (period == 1) snprintf(prefix, sizeof prefix, "xs%llu_", (unsigned long long)shape_population(s));
+    else snprintf(prefix, sizeof prefix, "x%c%d_", ox || oy ? 'q' : 'p', period);
+    memmove(best + strlen(prefix), best, strlen(best) + 1);
+    memcpy(best, prefix, strlen(prefix));
+    return find_kind(best);
+}
+
+ // Shapes are only the kinds they were classified as under the same rule,
+ // and only have their common names under Life's.
+static void forget_other_rules () {
+    if (census_birth == rule.birth_mask && census_survive == rule.survive_mask) return;
+    int i;
+    for (i = 0; i < nkinds; i++) free(kinds[i].code);
+    nkinds = 0;
+    if (seen) memset(seen, 0, seen_cap * sizeof(Seen));
+    nseen = 0;
+    census_birth = rule.birth_mask;
+    census_survive = rule.survive_mask;
+}
+
+static int lookup (const Shape* s) {
+    if (nseen * 2 >= seen_cap) {
+        Seen* old = seen;
+        size_t old_cap = seen_cap, i;
+        seen_cap = seen_cap ? seen_cap * 2 : 1024;
+        seen = calloc(seen_cap, sizeof(Seen));
+        for (i = 0; i < old_cap; i++) {
+            if (!old[i].hash) continue;
+            size_t j = old[i].hash & (seen_cap - 1);
+            while (seen[j].hash) j = (j + 1) & (seen_cap - 1);
+            seen[j] = old[i];
+        }
+        free(old);
+    }
+    uint64_t h = shape_hash(s);
+    size_t j = h & (seen_cap - 1);
+    while (seen[j].hash) {
+        if (seen[j].hash == h && shape_equal(&seen[j].shape, s)) return seen[j].kind;
+        j = (j + 1) & (seen_cap - 1);
+    }
+    int kind = classify(s);
+    seen[j].hash = h;
+    seen[j].kind = kind;
+    seen[j].shape = *s;
+    nseen++;
+    return kind;
+}
+
+static void count_object (const Shape* s) {
+     // Not kinds[lookup(s)], since classifying may move kinds.
+    int kind = lookup(s);
+    if (kind != SPLIT) {
+        kinds[kind].count++;
+        return;
+    }
+    uint64_t parts [CENSUS_MAX_PIECES][SHAPE_MAX];
+    int n = pieces(s, parts, CENSUS_MAX_PIECES), i, x0, y0;
+    for (i = 0; i < n; i++) {
+        Shape part;
+        crop(parts[i], s->h, &part, &x0, &y0);
+        count_object(&part);
+    }
+}
+
+static int find (int i) {
+    while (run_parent[i] != i) {
+        run_parent[i] = run_parent[run_parent[i]];
+        i = run_parent[i];
+    }
+    return i;
+}
+
+static void unite (int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a < b) run_parent[b] = a;
+    else if (b < a) run_parent[a] = b;
+}
+
+ // Bits of word j of row where a run starts or ends.
+static uint64_t run_starts (const uint64_t* row, int j) {
+    uint64_t carry = j ? row[j - 1] >> 63 : 0;
+    return row[j] & ~(row[j] << 1 | carry);
+}
+static uint64_t run_ends (const uint64_t* row, int j, int words) {
+    uint64_t carry = j + 1 < words ? row[j + 1] << 63 : 0;
+    return row[j] & ~(row[j] >> 1 | carry);
+}
+
+ // Joins the runs of row ya that come within two cells of runs of row yb,
+ // which is one of the two rows below or the same row.
+static void link_rows (const Board* b, int ya, int yb) {
+    int i = row_first[ya], ia = row_first[ya + 1];
+    int j = row_first[yb], jb = row_first[yb + 1];
+    if (i == ia || j == jb) return;
+    if (b->wrap) {
+        if (run_x0[i] + b->width - run_x1[jb - 1] <= 2) unite(i, jb - 1);
+        if (run_x0[j] + b->width - run_x1[ia - 1] <= 2) unite(j, ia - 1);
+    }
+    if (ya == yb) {
+        for (; i + 1 < ia; i++) {
+            if (run_x0[i + 1] - run_x1[i] <= 2) unite(i, i + 1);
+        }
+        return;
+    }
+    while (i < ia && j < jb) {
+        if (run_x1[i] + 2 < run_x0[j]) i++;
+        else if (run_x1[j] + 2 < run_x0[i]) j++;
+        else {
+            unite(i, j);
+            if (run_x1[i] < run_x1[j]) i++;
+            else j++;
+        }
+    }
+}
+
+static void count_runs (Board* b, int y0, int y1, void* arg) {
+    (void)arg;
+    int y, j;
+    for (y = y0; y < y1; y++) {
+        const uint64_t* row = &b->cells[(size_t)y * b->words];
+        int n = 0;
+        for (j = 0; j < b->words; j++) {
+            if (row[j]) n += __builtin_popcountll(run_starts(row, j));
+        }
+        row_first[y + 1] = n;
+    }
+}
+
+ // The k-th start in a row belongs with the k-th end, so they're written
+ // out separately.
+static void find_runs (Board* b, int y0, int y1, void* arg) {
+    (void)arg;
+    int y, j;
+    for (y = y0; y < y1; y++) {
+        const uint64_t* row = &b->cells[(size_t)y * b->words];
+        int s = row_first[y], e = s;
+        for (j = 0; j < b->words; j++) {
+            if (!row[j]) continue;
+            uint64_t m;
+            for (m = run_starts(row, j); m; m &= m - 1) run_x0[s++] = j * 64 + __builtin_ctzll(m);
+            for (m = run_ends(row, j, b->words); m; m &= m - 1) run_x1[e++] = j * 64 + __builtin_ctzll(m);
+        }
+        for (s = row_first[y]; s < e; s++) {
+            run_y[s] = y;
+            run_parent[s] = s;
+        }
+        link_rows(b, y, y);
+        if (y > y0) link_rows(b, y, y - 1);
+        if (y > y0 + 1) link_rows(b, y, y - 2);
+    }
+}
+
+static int by_count (const void* a, const void* b) {
+    const Kind* ka = &kinds[*(const int*)a];
+    const Kind* kb = &kinds[*(const int*)b];
+    if (ka->count != kb->count) return ka->count < kb->count ? 1 : -1;
+    return code_before(ka->code, kb->code) ? -1 : 1;
+}
+
+void census_report (Board* b) {
+    if (rule.states > 2 || rule.radius > 1 || rule.middle || rule.birth_mask & 1) {
+        printf("No census for %s\n", rule.name);
+        return;
+    }
+    double start = now();
+    forget_other_rules();
+    if (b->height + 1 > rows_cap) {
+        rows_cap = b->height + 1;
+        row_first = realloc(row_first, rows_cap * sizeof(int));
+    }
+    row_first[0] = 0;
+    threaded_rows(b, count_runs, NULL);
+    int y, i;
+    for (y = 0; y < b->height; y++) row_first[y + 1] += row_first[y];
+    int nruns = row_first[b->height];
+    if (nruns > runs_cap) {
+        runs_cap = nruns;
+        run_x0 = realloc(run_x0, runs_cap * sizeof(int));
+        run_x1 = realloc(run_x1, runs_cap * sizeof(int));
+        run_y = realloc(run_y, runs_cap * sizeof(int));
+        run_parent = realloc(run_parent, runs_cap * sizeof(int));
+        run_order = realloc(run_order, runs_cap * sizeof(int));
+    }
+    threaded_rows(b, find_runs, NULL);
+     // Join across the bands the threads took, and around the top and
+     // bottom when wrapping.
+    for (i = 1; i < threads; i++) {
+        y = (int64_t)b->height * i / threads;
+        if (y < 1 || y >= b->height) continue;
+        link_rows(b, y, y - 1);
+        if (y > 1) link_rows(b, y, y - 2);
+        if (y + 1 < b->height) link_rows(b, y + 1, y - 1);
+    }
+    if (b->wrap && b->height > 2) {
+        link_rows(b, 0, b->height - 1);
+        link_rows(b, 0, b->height - 2);
+        link_rows(b, 1, b->height - 1);
+    }
+
+     // Sort the runs by component, numbering each by its root.
+    int* comp_start = calloc(nruns + 1, sizeof(int));
+    int ncomps = 0;
+    for (i = 0; i < nruns; i++) run_parent[i] = find(i);
+    for (i = 0; i < nruns; i++) {
+        if (run_parent[i] == i) comp_start[i] = ncomps++;
+    }
+    int* first = calloc(ncomps + 1, sizeof(int));
+    for (i = 0; i < nruns; i++) first[comp_start[run_parent[i]] + 1]++;
+    for (i = 0; i < ncomps; i++) first[i + 1] += first[i];
+    int* fill = malloc((ncomps + 1) * sizeof(int));
+    memcpy(fill, first, (ncomps + 1) * sizeof(int));
+    for (i = 0; i < nruns; i++) run_order[fill[comp_start[run_parent[i]]]++] = i;
+    free(fill);
+    free(comp_start);
+
+    for (i = 0; i < nkinds; i++) kinds[i].count = 0;
+    int c, k;
+    for (c = 0; c < ncomps; c++) {
+         // Objects cut by a wrapping edge touch both sides, and are put
+         // back together by moving the half nearer the low side across.
+        int left = 0, right = 0, bottom = 0, top = 0;
+        for (k = first[c]; k < first[c + 1]; k++) {
+            int r = run_order[k];
+            left |= run_x0[r] == 0;
+            right |= run_x1[r] == b->width - 1;
+            bottom |= run_y[r] == 0;
+            top |= run_y[r] == b->height - 1;
+        }
+        int shift_x = b->wrap && left && right;
+        int shift_y = b->wrap && bottom && top;
+        int xmin = 2 * b->width, xmax = -1, ymin = 2 * b->height, ymax = -1;
+        for (k = first[c]; k < first[c + 1]; k++) {
+            int r = run_order[k];
+            int dx = shift_x && run_x0[r] < b->width / 2 ? b->width : 0;
+            int ry = run_y[r] + (shift_y && run_y[r] < b->height / 2 ? b->height : 0);
+            if (xmin > run_x0[r] + dx) xmin = run_x0[r] + dx;
+            if (xmax < run_x1[r] + dx) xmax = run_x1[r] + dx;
+            if (ymin > ry) ymin = ry;
+            if (ymax < ry) ymax = ry;
+        }
+        if (xmax - xmin + 1 > SHAPE_MAX - 2 || ymax - ymin + 1 > SHAPE_MAX - 2) {
+            int kind = find_kind("oversized");
+            kinds[kind].count++;
+            continue;
+        }
+        Shape s;
+        memset(&s, 0, sizeof s);
+        s.w = xmax - xmin + 1;
+        s.h = ymax - ymin + 1;
+        for (k = first[c]; k < first[c + 1]; k++) {
+            int r = run_order[k];
+            int dx = shift_x && run_x0[r] < b->width / 2 ? b->width : 0;
+            int ry = run_y[r] + (shift_y && run_y[r] < b->height / 2 ? b->height : 0);
+            int n = run_x1[r] - run_x0[r] + 1;
+            uint64_t bits = n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+            s.rows[ry - ymin] |= bits << (run_x0[r] + dx - xmin);
+        }
+        count_object(&s);
+    }
+    free(first);
+
+    int* order = malloc((nkinds + 1) * sizeof(int));
+    int shown = 0;
+    for (i = 0; i < nkinds; i++) {
+        if (kinds[i].count) order[shown++] = i;
+    }
+    qsort(order, shown, sizeof(int), by_count);
+    uint64_t objects = 0;
+    for (i = 0; i < shown; i++) objects += kinds[order[i]].count;
+    printf("Census of generation %llu: %llu objects of %d kinds in %.3fs\n",
+        (unsigned long long)b->generation, (unsigned long long)objects, shown, now() - start
+    );
+    for (i = 0; i < shown; i++) {
+        Kind* kd = &kinds[order[i]];
+        printf("%12llu %s%s%s%s\n", (unsigned long long)kd->count, kd->code,
+            kd->name ? " (" : "", kd->name ? kd->name : "", kd->name ? ")" : ""
+        );
+    }
+    free(order);
+}
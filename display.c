@@ -0,0 +1,862 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <GL/glew.h>
+#include <GL/glfw.h>
+#include "golsh.h"
+
+int advance_frame = 0;
+int rewind_frame = 0;
+GLuint tex1, tex2;
+GLuint fb1, fb2;
+int use2 = 0;
+int exiting = 0;
+Board* board;
+ // Whether board has what the GPU has, which it doesn't after a GPU step
+ // that wasn't downloaded.
+int board_synced = 1;
+Board* stamp;
+GLuint packed_step_prog;
+GLuint packed_show_prog;
+int texels_across;  // Per row with -packed
+ // The view is the cell at the window's bottom left corner and the cells
+ // per pixel across and down.  Until panned or zoomed it fits the board.
+double view_x0, view_y0, view_sx, view_sy;
+int view_fit = 1;
+int last_wheel;
+GLuint density_prog;
+GLuint density_tex;
+unsigned char* density_map;
+int tex_stale;  // The texture is behind the newest turbo frame
+int mip_stale;  // The mip pyramid is
+
+void glerr (const char* when) {
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        fprintf(stderr, "OpenGL error 0x%04X %s\n", err, when);
+        glerr(when);
+    }
+}
+
+const char* vssrc =
+    "#version 110\n"
+    "uniform vec4 view;\n"
+    "attribute vec2 pos;\n"
+    "varying vec2 tp;\n"
+    "void main () {\n"
+    "    tp = view.xy + pos * view.zw;\n"
+    "    gl_Position = vec4(pos.x*2.0-1.0, pos.y*2.0-1.0, 0, 1);\n"
+    "}\n"
+;
+ // The step shader is put together for the rule by rule_shader, which puts
+ // the rule's radius, states and counts in front of this as constants for
+ // the GLSL compiler to fold and unroll.
+const char* fssrc =
+    "uniform bool do_calc;\n"
+    "uniform bool trails;\n"
+    "uniform sampler2D tex;\n"
+    "uniform vec2 tex_size;\n"
+    "varying vec2 tp;\n"
+    "void main () {\n"
+    "    if (do_calc) {\n"
+    "        vec4 old = texture2D(tex, tp);\n"
+    "        int count = 0;\n"
+    "        for (int dy = -RADIUS; dy <= RADIUS; dy++) {\n"
+    "            for (int dx = -RADIUS; dx <= RADIUS; dx++) {\n"
+    "                count += int(texture2D(tex, tp + vec2(float(dx), float(dy)) / tex_size).r);\n"
+    "            }\n"
+    "        }\n"
+    "        bool alive = old.r == 1.0;\n"
+    "        if (alive && !MIDDLE) count -= 1;\n"
+    "        int age = int(old.a * 255.0 + 0.5);\n"
+    "        if (alive ? survives(count) : age == 0 && born(count)) {\n"
+    "            gl_FragColor = vec4(1.0, 1.0, 1.0, 0.0);\n"
+    "        }\n"
+    "        else {\n"
+    "            float trail = trails\n"
+    "                ? old.b <= 32.0/255.0 ? old.b : old.b - (1.0/255.0)\n"
+    "                : 0.0;\n"
+    "            if (alive) age = STATES - 2;\n"
+    "            else if (age > 0) age -= 1;\n"
+    "            gl_FragColor = vec4(0.0, 0.0, trail, float(age) / 255.0);\n"
+    "        }\n"
+    "    }\n"
+    "    else {\n"
+    "        vec4 c = texture2D(tex, tp);\n"
+    "        gl_FragColor = vec4(max(c.r, c.a * 255.0 / float(STATES - 1)), c.g, c.b, 1.0);\n"
+    "    }\n"
+    "}\n"
+;
+
+ // Writes a GLSL condition on n for the counts set in table.
+static char* count_condition (char* p, const unsigned char* table, int max) {
+    int lo, hi;
+    p += sprintf(p, "false");
+    for (lo = 0; lo <= max; lo = hi + 1) {
+        hi = lo;
+        if (!table[lo]) continue;
+        while (hi < max && table[hi + 1]) hi++;
+        if (lo == hi) p += sprintf(p, " || n == %d", lo);
+        else p += sprintf(p, " || (n >= %d && n <= %d)", lo, hi);
+    }
+    return p;
+}
+
+char* rule_shader () {
+    int max = (2 * rule.radius + 1) * (2 * rule.radius + 1);
+    char* src = malloc(strlen(fssrc) + 60 * (max + 1) + 256);
+    char* p = src;
+    p += sprintf(p, "#version 110\n#define RADIUS %d\n#define MIDDLE %s\n#define STATES %d\n",
+        rule.radius, rule.middle ? "true" : "false", rule.states
+    );
+    p += sprintf(p, "bool born (int n) {\n    return ");
+    p = count_condition(p, rule.birth, max);
+    p += sprintf(p, ";\n}\nbool survives (int n) {\n    return ");
+    p = count_condition(p, rule.survive, max);
+    p += sprintf(p, ";\n}\n");
+    strcpy(p, fssrc);
+    return src;
+}
+
+GLuint compile_shader (GLenum type, const char* src, const char* what) {
+    GLint status;
+    GLint loglen;
+    GLuint id = glCreateShader(type);
+    int len = strlen(src);
+    glShaderSource(id, 1, &src, &len);
+    glCompileShader(id);
+    glGetShaderiv(id, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &loglen);
+    if (!status || loglen > 1) {
+        char log [loglen];
+        glGetShaderInfoLog(id, loglen, NULL, log);
+        fprintf(stderr, "Shader info log for %s:\n", what);
+        fputs(log, stderr);
+        if (!status) {
+            fprintf(stderr, "Failed to compile GL shader.\n");
+            exit(1);
+        }
+    }
+    glerr("after compiling shader");
+    return id;
+}
+
+GLuint link_program (GLuint vsid, GLuint fsid) {
+    GLint status;
+    GLint loglen;
+    GLuint prid = glCreateProgram();
+    glAttachShader(prid, vsid);
+    glAttachShader(prid, fsid);
+    glBindAttribLocation(prid, 0, "pos");
+    glLinkProgram(prid);
+    glGetProgramiv(prid, GL_LINK_STATUS, &status);
+    glGetProgramiv(prid, GL_INFO_LOG_LENGTH, &loglen);
+    if (!status || loglen > 1) {
+        char log [loglen];
+        glGetProgramInfoLog(prid, loglen, NULL, log);
+        fprintf(stderr, "Program info log:\n");
+        fputs(log, stderr);
+        if (!status) {
+            fprintf(stderr, "Failed to link GL program.\n");
+            exit(1);
+        }
+    }
+    glerr("after linking program");
+    return prid;
+}
+
+ // With -packed the textures are R32UI, 32 cells to a texel as in
+ // packed.c, whose functions go between these two to make the step shader.
+ // Each fragment steps one texel from the nine around it; a second shader
+ // picks the cells out of the texels for display.
+const char* packed_vssrc =
+    "#version 130\n"
+    "uniform vec4 view;\n"
+    "in vec2 pos;\n"
+    "out vec2 tp;\n"
+    "void main () {\n"
+    "    tp = view.xy + pos * view.zw;\n"
+    "    gl_Position = vec4(pos.x*2.0-1.0, pos.y*2.0-1.0, 0, 1);\n"
+    "}\n"
+;
+const char* packed_head_src =
+    "#version 130\n"
+    "uniform usampler2D tex;\n"
+    "uniform ivec2 texels;\n"
+    "uniform int last_tail;\n"
+    "uniform bool wrap;\n"
+    "uniform uint birth;\n"
+    "uniform uint survive;\n"
+    "out uvec4 result;\n"
+;
+const char* packed_step_src =
+    "\n"
+    "uint at (ivec2 p) {\n"
+    "    if (wrap) p = (p + texels) % texels;\n"
+    "    else if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, texels))) return 0u;\n"
+    "    return texelFetch(tex, p, 0).r;\n"
+    "}\n"
+    "void main () {\n"
+    "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "    int tail = p.x == texels.x - 1 ? last_tail : 32;\n"
+    "    int ltail = p.x == 0 ? last_tail : 32;\n"
+    "    result = uvec4(packed_texel(\n"
+    "        at(p + ivec2(-1, 1)), at(p + ivec2(0, 1)), at(p + ivec2(1, 1)),\n"
+    "        at(p + ivec2(-1, 0)), at(p), at(p + ivec2(1, 0)),\n"
+    "        at(p + ivec2(-1, -1)), at(p + ivec2(0, -1)), at(p + ivec2(1, -1)),\n"
+    "        tail, ltail, birth, survive\n"
+    "    ), 0u, 0u, 0u);\n"
+    "}\n"
+;
+const char* packed_show_src =
+    "#version 130\n"
+    "uniform usampler2D tex;\n"
+    "uniform ivec2 size;\n"
+    "in vec2 tp;\n"
+    "out vec4 color;\n"
+    "void main () {\n"
+    "    ivec2 c = ivec2(floor(tp * vec2(size)));\n"
+    "    float v = 0.0;\n"
+    "    if (all(greaterThanEqual(c, ivec2(0))) && all(lessThan(c, size))) {\n"
+    "        uint word = texelFetch(tex, ivec2(c.x / 32, c.y), 0).r;\n"
+    "        v = float((word >> uint(c.x % 32)) & 1u);\n"
+    "    }\n"
+    "    color = vec4(v, v, v, 1.0);\n"
+    "}\n"
+;
+
+ // Zoomed out past MIP_BASE cells a pixel, the window shows a density map
+ // drawn from the mip pyramid instead of the board's texture.
+const char* density_fssrc =
+    "#version 110\n"
+    "uniform sampler2D tex;\n"
+    "varying vec2 tp;\n"
+    "void main () {\n"
+    "    gl_FragColor = vec4(texture2D(tex, tp).rrr, 1.0);\n"
+    "}\n"
+;
+
+ // Alive cells go in luminance and the ages of dying ones in alpha.
+void upload_board () {
+    int y;
+    if (packed) {
+         // A row of the board is already a row of texels.
+        for (y = 0; y < board->height; y++) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, texels_across, 1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                &board->cells[(size_t)y * board->words]
+            );
+        }
+        board_synced = 1;
+        return;
+    }
+    unsigned char* data = malloc(board->width * 2);
+    int x;
+    for (y = 0; y < board->height; y++) {
+        for (x = 0; x < board->width; x++) {
+            data[x * 2] = board_get(board, x, y) ? 0xff : 0x00;
+            data[x * 2 + 1] = board_get_age(board, x, y);
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, board->width, 1, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, data);
+    }
+    free(data);
+    board_synced = 1;
+}
+ // Uploads the rectangle from x0, y0 to x1, y1 inclusive in one go.
+void upload_rect (int x0, int y0, int x1, int y1) {
+    int w = x1 - x0 + 1, h = y1 - y0 + 1;
+    if (packed) {
+        int t0 = x0 / 32, n = x1 / 32 - t0 + 1;
+        uint32_t* texels = malloc((size_t)n * h * sizeof(uint32_t));
+        int y;
+        for (y = y0; y <= y1; y++) {
+            memcpy(&texels[(size_t)(y - y0) * n], (uint32_t*)&board->cells[(size_t)y * board->words] + t0,
+                n * sizeof(uint32_t)
+            );
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, t0, y0, n, h, GL_RED_INTEGER, GL_UNSIGNED_INT, texels);
+        free(texels);
+        return;
+    }
+    unsigned char* data = malloc((size_t)w * h * 2);
+    unsigned char* p = data;
+    int x, y;
+    for (y = y0; y <= y1; y++) {
+        for (x = x0; x <= x1; x++) {
+            *p++ = board_get(board, x, y) ? 0xff : 0x00;
+            *p++ = board_get_age(board, x, y);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, w, h, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, data);
+    free(data);
+}
+ // Copies the generation the GPU just computed back into the board, so it
+ // can be recorded in the history.
+void download_board () {
+    if (packed) {
+        uint32_t* texels = malloc((size_t)texels_across * board->height * sizeof(uint32_t));
+        int y;
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, texels);
+        for (y = 0; y < board->height; y++) {
+            uint64_t* row = &board->cells[(size_t)y * board->words];
+            row[board->words - 1] = 0;
+            memcpy(row, &texels[(size_t)y * texels_across], texels_across * sizeof(uint32_t));
+        }
+        free(texels);
+        board_synced = 1;
+        return;
+    }
+     // Under a Generations rule the ages of dying cells come back from alpha.
+    int aging = rule.states > 2;
+    int stride = aging ? 4 : 1;
+    unsigned char* data = malloc((size_t)board->width * board->height * stride);
+    int x, y, p;
+    if (aging) board_ensure_ages(board);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, aging ? GL_RGBA : GL_RED, GL_UNSIGNED_BYTE, data);
+    for (y = 0; y < board->height; y++) {
+        const unsigned char* src = &data[(size_t)y * board->width * stride];
+        uint64_t* row = &board->cells[(size_t)y * board->words];
+        memset(row, 0, board->words * sizeof(uint64_t));
+        for (p = 0; p < board->age_planes; p++) {
+            memset(&board->ages[((size_t)p * board->height + y) * board->words], 0,
+                board->words * sizeof(uint64_t)
+            );
+        }
+        for (x = 0; x < board->width; x++) {
+            uint64_t bit = (uint64_t)1 << (x % 64);
+            if (src[x * stride] & 0x80) row[x / 64] |= bit;
+            else if (aging) {
+                int age = src[x * stride + 3];
+                for (p = 0; p < board->age_planes; p++) {
+                    if (age >> p & 1) board->ages[((size_t)p * board->height + y) * board->words + x / 64] |= bit;
+                }
+            }
+        }
+    }
+    free(data);
+    board_synced = 1;
+}
+ // Uploads a frame from the simulation thread in turbo mode.  Frames carry
+ // only the live cells, so Generations rules show no dying ones here.
+void upload_cells (const uint64_t* cells) {
+    int x, y;
+    if (packed) {
+        for (y = 0; y < board->height; y++) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, texels_across, 1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                &cells[(size_t)y * board->words]
+            );
+        }
+        return;
+    }
+    unsigned char* data = malloc(board->width * 2);
+    for (y = 0; y < board->height; y++) {
+        const uint64_t* row = &cells[(size_t)y * board->words];
+        for (x = 0; x < board->width; x++) {
+            data[x * 2] = row[x / 64] >> (x % 64) & 1 ? 0xff : 0x00;
+            data[x * 2 + 1] = 0;
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, board->width, 1, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, data);
+    }
+    free(data);
+}
+ // In turbo mode the board belongs to the simulation thread, so changes to
+ // it wait for the batch in progress and show up in the next frame.
+void begin_edit () {
+    if (turbo) sim_lock();
+}
+void end_edit () {
+    if (turbo) sim_unlock();
+    else upload_board();
+}
+void randomize () {
+    begin_edit();
+    seed++;
+    board_randomize(board);
+    history_record(board);
+    end_edit();
+}
+void clear () {
+    begin_edit();
+    board_clear(board);
+    history_record(board);
+    end_edit();
+}
+ // Moves by some number of generations within the history, pausing.
+void seek (long long by) {
+    begin_edit();
+    uint64_t oldest, newest;
+    history_range(&oldest, &newest);
+    long long to = (long long)board->generation + by;
+    if (to < (long long)oldest) to = oldest;
+    if (to > (long long)newest) to = newest;
+    history_seek(board, to);
+    end_edit();
+    paused = 1;
+    if (turbo) sim_pause(1);
+}
+ // Switches between stepping on the GPU and on the simulation thread.
+void toggle_turbo () {
+    glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+    if (turbo) {
+        sim_stop();
+        turbo = 0;
+        upload_board();
+    }
+    else {
+        download_board();
+        turbo = 1;
+        sim_start(board, paused);
+    }
+    glfwSwapInterval(turbo);
+}
+
+void fit_view () {
+    view_x0 = view_y0 = 0;
+    view_sx = (double)width / window_width;
+    view_sy = (double)height / window_height;
+    view_fit = 1;
+}
+int zoomed_out () {
+    return view_sx >= MIP_BASE && view_sy >= MIP_BASE;
+}
+ // Zooms by factor, keeping the cell under the pixel at mx, my still.
+void zoom_view (double factor, int mx, int my) {
+    my = window_height - my - 1;
+    view_x0 += (mx + 0.5) * view_sx * (1 - factor);
+    view_y0 += (my + 0.5) * view_sy * (1 - factor);
+    view_sx *= factor;
+    view_sy *= factor;
+    view_fit = 0;
+}
+void pan_view (int dx, int dy) {
+    view_x0 += dx * view_sx;
+    view_y0 += dy * view_sy;
+    view_fit = 0;
+}
+void set_view (GLint uni_view) {
+    glUniform4f(uni_view, view_x0 / width, view_y0 / height,
+        window_width * view_sx / width, window_height * view_sy / height
+    );
+}
+ // The cell under window pixel mx, my, counting from the top.
+void to_cell (int mx, int my, int* x, int* y) {
+    *x = (int)floor(view_x0 + (mx + 0.5) * view_sx);
+    *y = (int)floor(view_y0 + (window_height - my - 0.5) * view_sy);
+}
+
+int GLFWCALL close_cb () {
+    exiting = 1;
+    return GL_TRUE;
+}
+void GLFWCALL key_cb (int code, int action) {
+    if (action == GLFW_PRESS) {
+        switch (code) {
+            case GLFW_KEY_ESC:
+                glfwTerminate();
+                exit(0);
+            case ' ':
+                paused = !paused;
+                if (turbo) sim_pause(paused);
+                break;
+            case '-':
+                fps /= 2;
+                break;
+            case '=':
+                fps *= 2;
+                break;
+            case 'R':
+                randomize();
+                break;
+            case 'C':
+                clear();
+                break;
+            case 'T':
+                toggle_turbo();
+                break;
+            case '.':
+                if (paused)
+                    advance_frame = 1;
+                else
+                    paused = 1;
+                if (turbo) sim_pause(1);
+                break;
+            case GLFW_KEY_BACKSPACE:
+                if (paused)
+                    rewind_frame = 1;
+                else
+                    paused = 1;
+                if (turbo) sim_pause(1);
+                break;
+            case GLFW_KEY_PAGEUP:
+                seek(-100);
+                break;
+            case GLFW_KEY_PAGEDOWN:
+                seek(100);
+                break;
+            case GLFW_KEY_HOME:
+                seek(-(long long)board->generation);
+                break;
+            case GLFW_KEY_END:
+                seek(1LL << 62);
+                break;
+            case GLFW_KEY_LEFT:
+                pan_view(-window_width / 8, 0);
+                break;
+            case GLFW_KEY_RIGHT:
+                pan_view(window_width / 8, 0);
+                break;
+            case GLFW_KEY_UP:
+                pan_view(0, window_height / 8);
+                break;
+            case GLFW_KEY_DOWN:
+                pan_view(0, -window_height / 8);
+                break;
+            case '0':
+                fit_view();
+                break;
+            default:
+                break;
+        }
+    }
+}
+void GLFWCALL resize_cb (int w, int h) {
+    window_width = w;
+    window_height = h;
+    if (view_fit) fit_view();
+}
+void GLFWCALL wheel_cb (int pos) {
+    int x, y;
+    glfwGetMousePos(&x, &y);
+    zoom_view(pow(0.8, pos - last_wheel), x, y);
+    last_wheel = pos;
+}
+
+ // Applies whatever was drawn since the last frame, in one batch.
+void flush_brush () {
+    int x0, y0, x1, y1;
+    if (!brush_dirty()) return;
+    if (turbo) {
+        sim_lock();
+        brush_apply(board, &x0, &y0, &x1, &y1);
+        sim_unlock();
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+    if (!board_synced) download_board();
+    if (brush_apply(board, &x0, &y0, &x1, &y1)) upload_rect(x0, y0, x1, y1);
+}
+
+int left_clicking = 0;
+int right_clicking = 0;
+int last_x, last_y;  // Where the mouse was last seen while drawing
+
+void GLFWCALL button_cb (int code, int action) {
+    if (action == GLFW_PRESS) {
+        int mx, my, x, y;
+        glfwGetMousePos(&mx, &my);
+        to_cell(mx, my, &x, &y);
+        last_x = x;
+        last_y = y;
+        if (code == GLFW_MOUSE_BUTTON_LEFT) {
+            left_clicking = 1;
+            brush_line(board, x, y, x, y, 1);
+        }
+        else if (code == GLFW_MOUSE_BUTTON_RIGHT) {
+            right_clicking = 1;
+            brush_line(board, x, y, x, y, 0);
+        }
+        else if (code == GLFW_MOUSE_BUTTON_MIDDLE && stamp) {
+            brush_stamp(board, stamp, x, y);
+        }
+    }
+    else {
+        if (code == GLFW_MOUSE_BUTTON_LEFT) {
+            left_clicking = 0;
+        }
+        else if (code == GLFW_MOUSE_BUTTON_RIGHT) {
+            right_clicking = 0;
+        }
+    }
+}
+void GLFWCALL motion_cb (int mx, int my) {
+    if (!left_clicking && !right_clicking) return;
+    int x, y;
+    to_cell(mx, my, &x, &y);
+    brush_line(board, last_x, last_y, x, y, left_clicking);
+    last_x = x;
+    last_y = y;
+}
+
+void run_display (Board* b) {
+    board = b;
+    if (stamp_filename) stamp = read_pattern(stamp_filename);
+    if (packed && (rule.states > 2 || rule.radius > 1 || rule.middle)) {
+        fprintf(stderr, "-packed only runs Life-like rules, not %s.\n", rule.name);
+        exit(1);
+    }
+    texels_across = (width + 31) / 32;
+     // The GPU only knows a fixed board, so unbounded universes always
+     // run on the simulation thread.
+    if (engine->step == hashlife_step || engine->step == infinite_step) turbo = 1;
+    glfwInit();
+    glfwOpenWindow(window_width, window_height, 8, 8, 8, 0, 0, 0, fullscreen ? GLFW_FULLSCREEN : GLFW_WINDOW);
+    glfwEnable(GLFW_MOUSE_CURSOR);
+    glfwDisable(GLFW_AUTO_POLL_EVENTS);
+    glfwSetWindowCloseCallback(close_cb);
+    glfwSetWindowSizeCallback(resize_cb);
+    glfwSetKeyCallback(key_cb);
+    glfwSetMouseButtonCallback(button_cb);
+    glfwSetMousePosCallback(motion_cb);
+    glfwSetMouseWheelCallback(wheel_cb);
+    last_wheel = glfwGetMouseWheel();
+    fit_view();
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        fprintf(stderr, "GLEW error: %s\n", glewGetErrorString(err));
+        exit(1);
+    }
+    GLuint vsid = compile_shader(GL_VERTEX_SHADER, vssrc, "vertex shader");
+    const char* rule_src = rule_shader();
+    GLuint fsid = compile_shader(GL_FRAGMENT_SHADER, rule_src, "fragment shader");
+    free((char*)rule_src);
+    GLuint prid = link_program(vsid, fsid);
+    if (packed) {
+        GLuint packed_vs = compile_shader(GL_VERTEX_SHADER, packed_vssrc, "packed vertex shader");
+        char* src = malloc(strlen(packed_head_src) + strlen(packed_glsl) + strlen(packed_step_src) + 1);
+        strcpy(src, packed_head_src);
+        strcat(src, packed_glsl);
+        strcat(src, packed_step_src);
+        packed_step_prog = link_program(packed_vs, compile_shader(GL_FRAGMENT_SHADER, src, "packed step shader"));
+        free(src);
+        packed_show_prog = link_program(packed_vs, compile_shader(GL_FRAGMENT_SHADER, packed_show_src, "packed display shader"));
+        glUseProgram(packed_step_prog);
+        glUniform1i(glGetUniformLocation(packed_step_prog, "tex"), 0);
+        glUniform2i(glGetUniformLocation(packed_step_prog, "texels"), texels_across, height);
+        glUniform1i(glGetUniformLocation(packed_step_prog, "last_tail"), width - (texels_across - 1) * 32);
+        glUniform1i(glGetUniformLocation(packed_step_prog, "wrap"), wrap);
+        glUniform1ui(glGetUniformLocation(packed_step_prog, "birth"), rule.birth_mask);
+        glUniform1ui(glGetUniformLocation(packed_step_prog, "survive"), rule.survive_mask);
+        glUseProgram(packed_show_prog);
+        glUniform1i(glGetUniformLocation(packed_show_prog, "tex"), 0);
+        glUniform2i(glGetUniformLocation(packed_show_prog, "size"), width, height);
+        glerr("after setting packed uniforms");
+    }
+    GLint uni_packed_view = packed ? glGetUniformLocation(packed_show_prog, "view") : -1;
+    density_prog = link_program(vsid, compile_shader(GL_FRAGMENT_SHADER, density_fssrc, "density shader"));
+    glUseProgram(density_prog);
+    glUniform1i(glGetUniformLocation(density_prog, "tex"), 0);
+    glUniform4f(glGetUniformLocation(density_prog, "view"), 0, 0, 1, 1);
+    glGenTextures(1, &density_tex);
+    glBindTexture(GL_TEXTURE_2D, density_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(prid);
+    GLint uni_tex = glGetUniformLocation(prid, "tex");
+    GLint uni_tex_size = glGetUniformLocation(prid, "tex_size");
+    GLint uni_do_calc = glGetUniformLocation(prid, "do_calc");
+    GLint uni_trails = glGetUniformLocation(prid, "trails");
+    GLint uni_view = glGetUniformLocation(prid, "view");
+    glUniform1i(uni_tex, 0);
+    glUniform2f(uni_tex_size, width, height);
+    glUniform1i(uni_trails, trails);
+    glUniform4f(uni_view, 0, 0, 1, 1);
+    glerr("after getting uniforms");
+
+    GLint tex_format = packed ? GL_R32UI : GL_RGBA8;
+    int tex_width = packed ? texels_across : width;
+    GLenum data_format = packed ? GL_RED_INTEGER : GL_LUMINANCE;
+    GLenum data_type = packed ? GL_UNSIGNED_INT : GL_UNSIGNED_BYTE;
+    glGenTextures(1, &tex1);
+    glBindTexture(GL_TEXTURE_2D, tex1);
+    glTexImage2D(GL_TEXTURE_2D, 0, tex_format, tex_width, height, 0, data_format, data_type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (!wrap) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glerr("after creating tex 1");
+    glGenFramebuffers(1, &fb1);
+    glBindFramebuffer(GL_FRAMEBUFFER, fb1);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex1, 0);
+    glerr("after creating fb 1");
+    GLenum fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Framebuffer 1 creation failed: 0x%04X\n", fb_status);
+        exit(1);
+    }
+
+    glGenTextures(1, &tex2);
+    glBindTexture(GL_TEXTURE_2D, tex2);
+    glTexImage2D(GL_TEXTURE_2D, 0, tex_format, tex_width, height, 0, data_format, data_type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (!wrap) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glerr("after creating tex 2");
+    glGenFramebuffers(1, &fb2);
+    glBindFramebuffer(GL_FRAMEBUFFER, fb2);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex2, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glerr("after creating fb 2");
+    fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Framebuffer 2 creation failed: 0x%04X\n", fb_status);
+        exit(1);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, tex1);
+    upload_board();
+    if (history_depth > 0) history_reset(board);
+
+    float verts [8] = { 0, 0,  1, 0,  1, 1,  0, 1 };
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
+
+    if (turbo) {
+        sim_start(board, paused);
+        glfwSwapInterval(1);
+    }
+    double title_time = 0;
+    int first_frame = 1;
+    const uint64_t* cells = NULL;
+    uint64_t generation = 0;
+    while (!exiting) {
+        if (turbo) {
+            if (rewind_frame) {
+                begin_edit();
+                history_back(board);
+                end_edit();
+                rewind_frame = 0;
+            }
+            else if (advance_frame) {
+                begin_edit();
+                if (!history_forward(board)) {
+                    engine->step(board, 1);
+                    history_record(board);
+                }
+                end_edit();
+            }
+            if (sim_frame(&cells, &generation)) tex_stale = mip_stale = 1;
+             // Zoomed out, the texture isn't drawn, so only the pyramid
+             // is kept up with the frames.
+            if (zoomed_out()) {
+                if (mip_stale) mip_update(cells, width, height, board->words);
+                mip_stale = 0;
+            }
+            else if (tex_stale) {
+                glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                upload_cells(cells);
+                tex_stale = 0;
+            }
+            if (now() - title_time >= 1) {
+                char title [128];
+                snprintf(title, sizeof title, "golsh - generation %llu, %.0f gens/s",
+                    (unsigned long long)generation, paused ? 0 : sim_gens_per_sec
+                );
+                glfwSetWindowTitle(title);
+                title_time = now();
+            }
+        }
+        else if (rewind_frame) {
+            if (history_back(board)) {
+                glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                upload_board();
+            }
+            rewind_frame = 0;
+        }
+        else if (!first_frame && (!paused || advance_frame)) {
+            if (history_forward(board)) {
+                 // Replay what was stepped back past
+                glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                upload_board();
+            }
+            else {
+                 // Run a step
+                double t = now();
+                if (packed) glUseProgram(packed_step_prog);
+                else {
+                    glUniform1i(uni_do_calc, 1);
+                    glUniform4f(uni_view, 0, 0, 1, 1);
+                }
+                glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                glBindFramebuffer(GL_FRAMEBUFFER, use2 ? fb1 : fb2);
+                glViewport(0, 0, tex_width, height);
+                glDrawArrays(GL_QUADS, 0, 4);
+                 // Switch buffer
+                use2 = !use2;
+                board->generation++;
+                 // Reading the board back costs the GPU its lead, so it's
+                 // only done for the history if asked for, and for stats
+                 // when they're due.
+                int sample = stats_on && board->generation % stats_every == 0;
+                if (history_depth > 0 || sample) {
+                    glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                    download_board();
+                    history_record(board);
+                }
+                else board_synced = 0;
+                stats_time(STATS_STEP, t);
+                if (sample) stats_record(board);
+            }
+        }
+        first_frame = 0;
+        advance_frame = 0;
+        flush_brush();
+         // Copy to window
+        double render_start = now();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, window_width, window_height);
+        if (zoomed_out()) {
+            if (!turbo) {
+                if (!board_synced) {
+                    glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+                    download_board();
+                }
+                mip_update(board->cells, width, height, board->words);
+            }
+            density_map = realloc(density_map, (size_t)window_width * window_height);
+            mip_render(density_map, window_width, window_height, view_x0, view_y0, view_sx, view_sy);
+            glUseProgram(density_prog);
+            glBindTexture(GL_TEXTURE_2D, density_tex);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, window_width, window_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, density_map);
+            glDrawArrays(GL_QUADS, 0, 4);
+            if (!packed) glUseProgram(prid);
+        }
+        else {
+            if (packed) {
+                glUseProgram(packed_show_prog);
+                set_view(uni_packed_view);
+            }
+            else {
+                glUniform1i(uni_do_calc, 0);
+                set_view(uni_view);
+            }
+            glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
+            glDrawArrays(GL_QUADS, 0, 4);
+        }
+        glerr("after doing a render");
+        glfwSwapBuffers();
+        stats_time(STATS_RENDER, render_start);
+        if (turbo && !paused) {
+             // Presenting is paced by vsync while the simulation runs free.
+            glfwPollEvents();
+        }
+        else if (!paused) {
+            glfwSleep(1/fps);
+            glfwPollEvents();
+        }
+        else {
+            glfwWaitEvents();
+        }
+    }
+    if (turbo) sim_stop();
+}
@@ -0,0 +1,326 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Ensemble mode runs many small boards from consecutive seeds in one
+ // process, for soup searching.  Each board is at most 64 cells wide, so a
+ // row of it is one word, and the boards are packed side by side: word i of
+ // row y is board i's row y.  That makes stepping every board one
+ // generation a single pass down the rows, with the same word logic applied
+ // across all of them; the neighbors to the west and east come from
+ // rotating (or shifting, without -wrap) each word within the board's width.
+ // Each thread takes a contiguous run of boards and steps them together.
+ //
+ // A board is finished once its state repeats within ENSEMBLE_PERIOD
+ // generations, and a JSON line describing it is printed right away, so the
+ // results stream out in whatever order boards settle.  Once enough of a
+ // thread's boards have finished, the rest are moved down over them so that
+ // finished boards stop costing anything.
+#define ENSEMBLE_PERIOD 32
+
+int nboards;
+int board_rows;
+uint64_t ensemble_seed;
+uint64_t ensemble_gens;
+uint64_t ensemble_tail;
+uint64_t* ens_cells;  // Row-major, nboards words to a row
+uint64_t* ens_next;
+uint64_t* ens_zero;
+uint64_t* ens_hashes;  // ENSEMBLE_PERIOD per column, by generation % ENSEMBLE_PERIOD
+int* ens_board;  // Which board is in each column, or -1 once it's finished
+pthread_mutex_t ensemble_mutex = PTHREAD_MUTEX_INITIALIZER;
+int ensemble_settled;
+
+ // SplitMix64, whose state can start anywhere, so each seed gets a stream
+ // of its own without any shared generator between threads.
+static uint64_t splitmix (uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ z >> 30) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ z >> 27) * 0x94D049BB133111EBull;
+    return z ^ z >> 31;
+}
+
+ // A row of soup with cells alive with probability k / 65536, built up bit
+ // by bit from the lowest set bit of k as board_randomize does.  At the
+ // default density of a half that's a single word of the stream.
+static uint64_t soup_row (uint64_t* state, uint32_t k) {
+    if (k >= 65536 || !k) return k ? ~(uint64_t)0 : 0;
+    int bit = __builtin_ctz(k);
+    uint64_t w = splitmix(state);
+    for (bit++; bit < 16; bit++) {
+        if (k >> bit & 1) w |= splitmix(state);
+        else w &= splitmix(state);
+    }
+    return w;
+}
+
+ // Adds a row to a board's hash.  The shift brings the high bits of each
+ // product back down, or a difference in the board's high columns would
+ // only ever reach the top bits of the hash.
+static inline uint64_t hash_row (uint64_t h, uint64_t row) {
+    h = (h ^ row) * 0x9E3779B97F4A7C15ull;
+    return h ^ h >> 32;
+}
+
+ // Counts the 8-connected clusters of live cells, as a rough census.
+static int count_objects (const Board* b) {
+    size_t n = (size_t)b->width * b->height;
+    unsigned char* seen = calloc(n, 1);
+    int* stack = malloc(n * sizeof(int));
+    int objects = 0, x, y;
+    for (y = 0; y < b->height; y++) {
+        for (x = 0; x < b->width; x++) {
+            if (seen[(size_t)y * b->width + x] || !board_get(b, x, y)) continue;
+            objects++;
+            int top = 0;
+            stack[top++] = y * b->width + x;
+            seen[(size_t)y * b->width + x] = 1;
+            while (top) {
+                int c = stack[--top];
+                int cx = c % b->width, cy = c / b->width, dx, dy;
+                for (dy = -1; dy <= 1; dy++) {
+                    for (dx = -1; dx <= 1; dx++) {
+                        int nx = cx + dx, ny = cy + dy;
+                        if (b->wrap) {
+                            nx = (nx + b->width) % b->width;
+                            ny = (ny + b->height) % b->height;
+                        }
+                        if (nx < 0 || nx >= b->width || ny < 0 || ny >= b->height) continue;
+                        size_t k = (size_t)ny * b->width + nx;
+                        if (seen[k] || !board_get(b, nx, ny)) continue;
+                        seen[k] = 1;
+                        stack[top++] = k;
+                    }
+                }
+            }
+        }
+    }
+    free(seen);
+    free(stack);
+    return objects;
+}
+
+ // Prints board i's outcome, unpacking it into scratch to look at.
+static void report_board (const uint64_t* cells, int col, Board* scratch, uint64_t generation, int period) {
+    int y;
+    for (y = 0; y < board_rows; y++) scratch->cells[y] = cells[(size_t)y * nboards + col];
+    char stable [32] = "null";
+    char per [16] = "null";
+    if (period) {
+        snprintf(stable, sizeof stable, "%llu", (unsigned long long)(generation - period));
+        snprintf(per, sizeof per, "%d", period);
+    }
+    uint64_t pop = board_population(scratch);
+    int objects = count_objects(scratch);
+    pthread_mutex_lock(&ensemble_mutex);
+    printf("{\"seed\":%llu,\"stable\":%s,\"period\":%s,\"generation\":%llu,\"population\":%llu,\"objects\":%d}\n",
+        (unsigned long long)(ensemble_seed + ens_board[col]), stable, per, (unsigned long long)generation,
+        (unsigned long long)pop, objects
+    );
+    if (period) ensemble_settled++;
+    pthread_mutex_unlock(&ensemble_mutex);
+}
+
+ // A board's neighbors to the west are its words shifted up a bit, with its
+ // last column (bit sh) coming around to its first when wrap_mask is all
+ // ones, and likewise to the east.
+#define PACKED_WEST(x) (((x) << 1 | ((x) >> sh & wrap_mask)) & tail)
+#define PACKED_EAST(x) ((x) >> 1 | ((x) & wrap_mask & 1) << sh)
+#define PACKED_WORD(WORD, u, m, d) WORD( \
+    PACKED_WEST(u), u, PACKED_EAST(u), \
+    PACKED_WEST(m), m, PACKED_EAST(m), \
+    PACKED_WEST(d), d, PACKED_EAST(d) \
+)
+#define ENSEMBLE_LIFE(...) LIFE_WORD(__VA_ARGS__)
+#define ENSEMBLE_GENERIC(...) RULE_WORD(__VA_ARGS__, rule.birth_mask, rule.survive_mask)
+
+typedef void (*PackedSpan) (
+    const uint64_t* up, const uint64_t* mid, const uint64_t* down, uint64_t* out,
+    int i0, int i1, int sh, uint64_t wrap_mask, uint64_t tail
+);
+
+ // Unlike a board's row, the words here don't share bits, so the vector
+ // versions are plain loads with no offsets.
+#define PACKED_SPAN(name, ATTR, N, WORD) \
+typedef uint64_t name##_vec __attribute__((vector_size(N * 8))); \
+ATTR \
+static void name ( \
+    const uint64_t* up, const uint64_t* mid, const uint64_t* down, uint64_t* out, \
+    int i0, int i1, int sh, uint64_t wrap_mask, uint64_t tail \
+) { \
+    int i; \
+    for (i = i0; i + N <= i1; i += N) { \
+        name##_vec u, m, d; \
+        memcpy(&u, up + i, sizeof u); \
+        memcpy(&m, mid + i, sizeof m); \
+        memcpy(&d, down + i, sizeof d); \
+        name##_vec r = PACKED_WORD(WORD, u, m, d); \
+        memcpy(out + i, &r, sizeof r); \
+    } \
+    for (; i < i1; i++) { \
+        uint64_t u = up[i], m = mid[i], d = down[i]; \
+        out[i] = PACKED_WORD(WORD, u, m, d); \
+    } \
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AVX512 __attribute__((target("avx512f")))
+#define AVX2 __attribute__((target("avx2")))
+PACKED_SPAN(packed_avx512_life, AVX512, 8, ENSEMBLE_LIFE)
+PACKED_SPAN(packed_avx512_generic, AVX512, 8, ENSEMBLE_GENERIC)
+PACKED_SPAN(packed_avx2_life, AVX2, 4, ENSEMBLE_LIFE)
+PACKED_SPAN(packed_avx2_generic, AVX2, 4, ENSEMBLE_GENERIC)
+#endif
+PACKED_SPAN(packed_scalar_life, , 1, ENSEMBLE_LIFE)
+PACKED_SPAN(packed_scalar_generic, , 1, ENSEMBLE_GENERIC)
+
+ // The span matching the step kernel in use.
+static PackedSpan packed_span () {
+    int life = rule.kernel == RULE_LIFE;
+#if defined(__x86_64__) || defined(__i386__)
+    if (0==strcmp(kernel->name, "avx512")) return life ? packed_avx512_life : packed_avx512_generic;
+    if (0==strcmp(kernel->name, "avx2")) return life ? packed_avx2_life : packed_avx2_generic;
+#endif
+    return life ? packed_scalar_life : packed_scalar_generic;
+}
+
+ // Steps boards i0 to i1 one generation from cells into next, leaving a
+ // hash of each board's new state in hashes.
+static void step_boards (const uint64_t* cells, uint64_t* next, int i0, int i1, uint64_t* hashes) {
+    PackedSpan span = packed_span();
+    int y, i;
+    for (i = i0; i < i1; i++) hashes[i - i0] = 0;
+    for (y = 0; y < board_rows; y++) {
+        const uint64_t* up = y + 1 < board_rows ? &cells[(size_t)(y + 1) * nboards]
+            : wrap ? cells : ens_zero;
+        const uint64_t* mid = &cells[(size_t)y * nboards];
+        const uint64_t* down = y > 0 ? &cells[(size_t)(y - 1) * nboards]
+            : wrap ? &cells[(size_t)(board_rows - 1) * nboards] : ens_zero;
+        uint64_t* out = &next[(size_t)y * nboards];
+        span(up, mid, down, out, i0, i1, width - 1, wrap ? ~(uint64_t)0 : 0, ensemble_tail);
+        for (i = i0; i < i1; i++) hashes[i - i0] = hash_row(hashes[i - i0], out[i]);
+    }
+}
+
+ // Moves the unfinished boards in columns i0 to i1 down to the start, in
+ // both buffers' current state, returning the new end.
+static int compact (uint64_t* cells, int i0, int i1) {
+    int from, to = i0, y;
+    for (from = i0; from < i1; from++) {
+        if (ens_board[from] < 0) continue;
+        if (from != to) {
+            for (y = 0; y < board_rows; y++)
+                cells[(size_t)y * nboards + to] = cells[(size_t)y * nboards + from];
+            memcpy(&ens_hashes[(size_t)to * ENSEMBLE_PERIOD], &ens_hashes[(size_t)from * ENSEMBLE_PERIOD],
+                ENSEMBLE_PERIOD * sizeof(uint64_t));
+            ens_board[to] = ens_board[from];
+            ens_board[from] = -1;
+        }
+        to++;
+    }
+    return to;
+}
+
+static void* ensemble_thread (void* arg) {
+    int t = (int)(intptr_t)arg;
+    int i0 = (int64_t)nboards * t / threads;
+    int i1 = (int64_t)nboards * (t + 1) / threads;
+    int finished = 0;
+    uint64_t* hashes = malloc((i1 - i0 + 1) * sizeof(uint64_t));
+    Board* scratch = board_new(width, board_rows, wrap);
+     // Threads only ever look at their own boards, so each can swap its
+     // side of the buffers without waiting for the others.
+    uint64_t* cells = ens_cells;
+    uint64_t* next = ens_next;
+    uint64_t g;
+    int i, p;
+    for (g = 1; g <= ensemble_gens && i1 > i0; g++) {
+        step_boards(cells, next, i0, i1, hashes);
+        uint64_t* tmp = cells;
+        cells = next;
+        next = tmp;
+        for (i = i0; i < i1; i++) {
+            if (ens_board[i] < 0) continue;
+            uint64_t h = hashes[i - i0];
+            uint64_t* ring = &ens_hashes[(size_t)i * ENSEMBLE_PERIOD];
+            for (p = 1; p <= ENSEMBLE_PERIOD && (uint64_t)p <= g; p++) {
+                if (ring[(g - p) % ENSEMBLE_PERIOD] == h) break;
+            }
+            if (p <= ENSEMBLE_PERIOD && (uint64_t)p <= g) {
+                report_board(cells, i, scratch, g, p);
+                ens_board[i] = -1;
+                finished++;
+            }
+            else ring[g % ENSEMBLE_PERIOD] = h;
+        }
+        if (finished * 8 > i1 - i0) {
+            i1 = compact(cells, i0, i1);
+            finished = 0;
+        }
+    }
+    for (i = i0; i < i1; i++) {
+        if (ens_board[i] >= 0) report_board(cells, i, scratch, ensemble_gens, 0);
+    }
+    board_free(scratch);
+    free(hashes);
+    return NULL;
+}
+
+ // Runs n boards of width x height from seeds seed to seed + n - 1 for up
+ // to gens generations each.
+void run_ensemble (int n, uint64_t seed, uint64_t gens) {
+    if (n < 1 || width < 1 || height < 1) {
+        fprintf(stderr, "Invalid ensemble of %d %dx%d boards.\n", n, width, height);
+        exit(1);
+    }
+    if (width > 64) {
+        fprintf(stderr, "Ensemble boards can be at most 64 cells wide.\n");
+        exit(1);
+    }
+    if (rule.states > 2 || rule.radius > 1 || rule.middle) {
+        fprintf(stderr, "Ensemble mode only runs Life-like rules, not %s.\n", rule.name);
+        exit(1);
+    }
+    double start = now();
+    nboards = n;
+    board_rows = height;
+    ensemble_seed = seed;
+    ensemble_gens = gens;
+    ensemble_tail = width % 64 ? ((uint64_t)1 << width % 64) - 1 : ~(uint64_t)0;
+    ens_cells = alloc_words((size_t)n * height);
+    ens_next = alloc_words((size_t)n * height);
+    ens_zero = alloc_words(n);
+    ens_hashes = alloc_words((size_t)n * ENSEMBLE_PERIOD);
+    ens_board = malloc(n * sizeof(int));
+    uint32_t k = density <= 0 ? 0 : density >= 1 ? 65536 : (uint32_t)(density * 65536 + 0.5);
+    int i, y;
+    for (i = 0; i < n; i++) {
+        ens_board[i] = i;
+        uint64_t state = seed + i;
+        uint64_t h = 0;
+        for (y = 0; y < height; y++) {
+            uint64_t r = soup_row(&state, k) & ensemble_tail;
+            ens_cells[(size_t)y * n + i] = r;
+            h = hash_row(h, r);
+        }
+        ens_hashes[(size_t)i * ENSEMBLE_PERIOD] = h;
+    }
+    pthread_t tids [threads];
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, ensemble_thread, (void*)(intptr_t)i)) {
+            fprintf(stderr, "Failed to create ensemble thread %d.\n", i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    fprintf(stderr, "%d %dx%d boards, %d settled within %llu generations, in %.3fs\n",
+        n, width, height, ensemble_settled, (unsigned long long)gens, now() - start
+    );
+    free(ens_cells);
+    free(ens_next);
+    free(ens_zero);
+    free(ens_hashes);
+    free(ens_board);
+}
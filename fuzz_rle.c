@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "golsh.h"
+
+ // A libFuzzer entry point for the RLE reader.  read_rle only slurps the
+ // file and exits on errors, so this feeds each input straight to
+ // parse_rle, the part that does the work, on a board a little smaller than
+ // most patterns and wider than a word, then checks that nothing was set in
+ // the bits past the end of each row.  The rule is put back each time, as
+ // a pattern's own rule replaces it.  The parser's warnings go to stderr,
+ // which -close_fd_mask=2 quiets.
+ //
+ // Built without libFuzzer (-DFUZZ_MAIN), it runs the files it's given
+ // once each instead, to replay a crash.
+
+int width, height, window_width, window_height, fullscreen, paused, trails;
+int wrap = 1;
+float fps;
+int seed = 1;
+
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int LLVMFuzzerTestOneInput (const uint8_t* data, size_t size) {
+    static Board* b;
+    if (!b) b = board_new(100, 37, 1);
+    select_rule("B3/S23");
+    board_clear(b);
+    char err [256];
+    RleInfo info;
+    memset(&info, 0, sizeof info);
+    parse_rle(b, (const char*)data, size, &info, err, sizeof err);
+    int y;
+    for (y = 0; y < b->height; y++) {
+        if (b->cells[(size_t)y * b->words + b->words - 1] & ~b->tail) abort();
+    }
+    if (b->ages) {
+        size_t i, n = (size_t)b->age_planes * b->height;
+        for (i = 0; i < n; i++) {
+            if (b->ages[i * b->words + b->words - 1] & ~b->tail) abort();
+        }
+    }
+    return 0;
+}
+
+#ifdef FUZZ_MAIN
+int main (int argc, char** argv) {
+    int i;
+    for (i = 1; i < argc; i++) {
+        FILE* f = fopen(argv[i], "rb");
+        if (!f) {
+            fprintf(stderr, "Can't open %s for reading.\n", argv[i]);
+            exit(1);
+        }
+        size_t cap = 1 << 16, len = 0, got;
+        char* data = malloc(cap);
+        while ((got = fread(data + len, 1, cap - len, f)) > 0) {
+            len += got;
+            if (len == cap) data = realloc(data, cap *= 2);
+        }
+        fclose(f);
+        printf("%s\n", argv[i]);
+        fflush(stdout);
+        LLVMFuzzerTestOneInput((const uint8_t*)data, len);
+        free(data);
+    }
+    return 0;
+}
+#endif
@@ -1,11 +1,8 @@
-#include <ctype.h>
-#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
-#include <GL/glew.h>
-#include <GL/glfw.h>
+#include "golsh.h"
 
 int width = 256;
 int height = 256;
@@ -13,391 +10,28 @@ int window_width = 512;
 int window_height = 512;
 int fullscreen = 0;
 int paused = 0;
-int advance_frame = 0;
-int rewind_frame = 0;
-int rewound = 0;
 int seed;
 float fps = 15;
-GLuint tex1, tex2;
-GLuint fb1, fb2;
-int use2 = 0;
-int exiting = 0;
 int wrap = 1;
 int trails = 0;
-
-void glerr (const char* when) {
-    GLenum err = glGetError();
-    if (err != GL_NO_ERROR) {
-        fprintf(stderr, "OpenGL error 0x%04X %s\n", err, when);
-        glerr(when);
-    }
-}
-
-const char* vssrc =
-    "#version 110\n"
-    "attribute vec2 pos;\n"
-    "varying vec2 tp;\n"
-    "void main () {\n"
-    "    tp = pos;\n"
-    "    gl_Position = vec4(pos.x*2.0-1.0, pos.y*2.0-1.0, 0, 1);\n"
-    "}\n"
-;
-const char* fssrc =
-    "#version 110\n"
-    "uniform bool do_calc;\n"
-    "uniform bool rewind;\n"
-    "uniform bool trails;\n"
-    "uniform sampler2D tex;\n"
-    "uniform vec2 tex_size;\n"
-    "varying vec2 tp;\n"
-    "void main () {\n"
-    "    if (do_calc) {\n"
-    "        float x = tp.x;\n"
-    "        float y = tp.y;\n"
-    "        float l = x - 1.0 / tex_size.x;\n"
-    "        float b = y - 1.0 / tex_size.y;\n"
-    "        float r = x + 1.0 / tex_size.x;\n"
-    "        float t = y + 1.0 / tex_size.y;\n"
-    "        vec4 old = texture2D(tex, vec2(x, y));\n"
-    "        float count = \n"
-    "            + texture2D(tex, vec2(l, b)).r\n"
-    "            + texture2D(tex, vec2(x, b)).r\n"
-    "            + texture2D(tex, vec2(r, b)).r\n"
-    "            + texture2D(tex, vec2(l, y)).r\n"
-    "            + texture2D(tex, vec2(r, y)).r\n"
-    "            + texture2D(tex, vec2(l, t)).r\n"
-    "            + texture2D(tex, vec2(x, t)).r\n"
-    "            + texture2D(tex, vec2(r, t)).r\n"
-    "        ;\n"
-    "        int history = int(old.a * 255.0) / 2;\n"
-    "        if (old.r == 1.0) history += 128;\n"
-    "        if (old.r == 1.0 ? count == 2.0 || count == 3.0 : count == 3.0) {\n"
-    "            gl_FragColor = vec4(1.0, 1.0, 1.0, float(history)/255.0);\n"
-    "        }\n"
-    "        else {\n"
-    "            float trail = trails\n"
-    "                ? old.b <= 32.0/255.0 ? old.b : old.b - (1.0/255.0)\n"
-    "                : 0.0;\n"
-    "            gl_FragColor = vec4(0.0, 0.0, trail, float(history)/255.0);\n"
-    "        }\n"
-    "    }\n"
-    "    else if (rewind) {\n"
-    "        vec4 old = texture2D(tex, tp);\n"
-    "        int history = int(old.a * 255.0);\n"
-    "        if (history >= 128)\n"
-    "            gl_FragColor = vec4(1.0, 1.0, 1.0, float(history*2)/255.0);\n"
-    "        else\n"
-    "            gl_FragColor = vec4(0.0, 0.0, 0.0, float(history*2)/255.0);\n"
-    "    }\n"
-    "    else {\n"
-    "        gl_FragColor = texture2D(tex, tp);\n"
-    "    }\n"
-    "}\n"
-;
-
-void randomize () {
-    unsigned char data[width*height];
-    uint i;
-    for (i = 0; i < width*height; i++) {
-        data[i] = rand() & 1 ? 0xff : 0x00;
-    }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
-}
-void clear () {
-    unsigned char data[width*height];
-    uint i;
-    for (i = 0; i < width*height; i++) {
-        data[i] = 0;
-    }
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
-}
-
-int GLFWCALL close_cb () {
-    exiting = 1;
-    return GL_TRUE;
-}
-void GLFWCALL key_cb (int code, int action) {
-    if (action == GLFW_PRESS) {
-        switch (code) {
-            case GLFW_KEY_ESC:
-                glfwTerminate();
-                exit(0);
-            case ' ':
-                paused = !paused;
-                break;
-            case '-':
-                fps /= 2;
-                break;
-            case '=':
-                fps *= 2;
-                break;
-            case 'R':
-                randomize();
-                break;
-            case 'C':
-                clear();
-                break;
-            case '.':
-                if (paused)
-                    advance_frame = 1;
-                else
-                    paused = 1;
-                break;
-            case GLFW_KEY_BACKSPACE:
-                if (paused)
-                    rewind_frame = 1;
-                else
-                    paused = 1;
-            default:
-                break;
-        }
-    }
-}
-void GLFWCALL resize_cb (int w, int h) {
-    window_width = w;
-    window_height = h;
-}
-
-void draw (int x, int y, int val) {
-    printf("Drawing at %d, %d\n", x, y);
-    unsigned char byte = val ? 0xff : 0x00;
-    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, 1, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE, &byte);
-}
-
-int left_clicking = 0;
-int right_clicking = 0;
-
-void GLFWCALL button_cb (int code, int action) {
-    if (action == GLFW_PRESS) {
-        int x, y;
-        glfwGetMousePos(&x, &y);
-        x = x * width / window_width;
-        y = (window_height - y - 1) * height / window_height;
-        if (code == GLFW_MOUSE_BUTTON_LEFT) {
-            left_clicking = 1;
-            draw(x, y, 1);
-        }
-        else if (code == GLFW_MOUSE_BUTTON_RIGHT) {
-            right_clicking = 1;
-            draw(x, y, 0);
-        }
-    }
-    else {
-        if (code == GLFW_MOUSE_BUTTON_LEFT) {
-            left_clicking = 0;
-        }
-        else if (code == GLFW_MOUSE_BUTTON_RIGHT) {
-            right_clicking = 0;
-        }
-    }
-}
-void GLFWCALL motion_cb (int x, int y) {
-    if (left_clicking) {
-        draw(x * width / window_width, (window_height - y - 1) * height / window_height, 1);
-    }
-    else if (right_clicking) {
-        draw(x * width / window_width, (window_height - y - 1) * height / window_height, 0);
-    }
-}
-
-enum ReadState {
-    WANT_X,
-    WANT_X_EQ,
-    WANT_X_VAL,
-    WANT_X_COMMA,
-    WANT_Y,
-    WANT_Y_EQ,
-    WANT_Y_VAL,
-    WANT_Y_COMMA,
-    WANT_DATA
-};
-
-void read_rle (const char* filename) {
-    FILE* f = fopen(filename, "r");
-    if (!f) {
-        fprintf(stderr, "Can't open %s for reading: %s\n", filename, strerror(errno));
-        exit(1);
-    }
-    int state = WANT_X;
-    int start_x = 0;
-    int start_y = height-1;
-    int x;
-    int y;
-    int comment = 0;
-    int c = fgetc(f);
-    for (;;) {
-        if (c == EOF) {
-            fprintf(stderr, "RLE parse error; premature EOF.\n");
-            exit(1);
-        }
-        else if (comment) {
-            if (c == '\n') {
-                comment = 0;
-            }
-            else {
-                c = fgetc(f);
-            }
-        }
-        else if (isspace(c)) {
-            c = fgetc(f);
-        }
-        else if (c == '#') {
-            comment = 1;
-            c = fgetc(f);
-        }
-        else switch (state) {
-            case WANT_X: {
-                if (c == 'x') {
-                    state = WANT_X_EQ;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected x but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_X_EQ: {
-                if (c == '=') {
-                    state = WANT_X_VAL;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected = but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_X_VAL: {
-                if (isdigit(c)) {
-                    x = c - '0';
-                    c = fgetc(f);
-                    while (isdigit(c)) {
-                        x *= 10;
-                        x += c - '0';
-                        c = fgetc(f);
-                    }
-                    if (x > width) {
-                        fprintf(stderr, "Sorry, this RLE file is too wide for me (%d > %d).\n", x, width);
-                        exit(1);
-                    }
-                    start_x = (width - x) / 2;
-                    state = WANT_X_COMMA;
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected number but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_X_COMMA: {
-                if (c == ',') {
-                    state = WANT_Y;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected , but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_Y: {
-                if (c == 'y') {
-                    state = WANT_Y_EQ;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected x but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_Y_EQ: {
-                if (c == '=') {
-                    state = WANT_Y_VAL;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected = but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_Y_VAL: {
-                if (isdigit(c)) {
-                    y = c - '0';
-                    c = fgetc(f);
-                    while (isdigit(c)) {
-                        y *= 10;
-                        y += c - '0';
-                        c = fgetc(f);
-                    }
-                    if (y > width) {
-                        fprintf(stderr, "Sorry, this RLE file is too tall for me (%d > %d).\n", y, height);
-                        exit(1);
-                    }
-                    start_y = (height + y) / 2 - 1;
-                    state = WANT_Y_COMMA;
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected number but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_Y_COMMA: {
-                if (c == ',') {
-                    comment = 1;
-                    state = WANT_DATA;
-                    x = start_x;
-                    y = start_y;
-                    c = fgetc(f);
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; expected , but got %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-            case WANT_DATA: {
-                int run_count = 1;
-                if (isdigit(c)) {
-                    run_count = c - '0';
-                    c = fgetc(f);
-                    while (isdigit(c)) {
-                        run_count *= 10;
-                        run_count += c - '0';
-                        c = fgetc(f);
-                    }
-                }
-                if (c == 'b' || c == 'o') {
-                    char dat [run_count];
-                    int i;
-                    for (i = 0; i < run_count; i++)
-                        dat[i] = c == 'o' ? 0xff : 0x00;
-                    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, run_count, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE, dat);
-                    x += run_count;
-                    c = fgetc(f);
-                }
-                else if (c == '$') {
-                    x = start_x;
-                    y -= run_count;
-                    c = fgetc(f);
-                }
-                else if (c == '!') {
-                    goto done_reading;
-                }
-                else {
-                    fprintf(stderr, "RLE parse error; unrecognized character %c.\n", c);
-                    exit(1);
-                }
-                break;
-            }
-        }
-    }
-    done_reading:
-    fclose(f);
-}
+int packed = 0;
+int turbo = 0;
+float frame_ms = 16;
+#ifdef NO_DISPLAY
+int headless = 1;
+#else
+int headless = 0;
+#endif
+long long gens = 1000;
+const char* kernel_name = NULL;
+int nthreads = 1;
+const char* engine_name = "tiled";
+const char* rule_name = NULL;
+const char* save_filename = NULL;
+const char* checkpoint_filename = NULL;
+long long checkpoint_every = 0;
+int ensemble = 0;
+const char* stamp_filename = NULL;
 
 int opt_i (char* arg, size_t len, const char* prefix, int* var) {
     if (0==strncmp(arg, prefix, len)) {
@@ -406,6 +40,13 @@ int opt_i (char* arg, size_t len, const char* prefix, int* var) {
     }
     return 0;
 }
+int opt_ll (char* arg, size_t len, const char* prefix, long long* var) {
+    if (0==strncmp(arg, prefix, len)) {
+        sscanf(arg+len, "%lld", var);
+        return 1;
+    }
+    return 0;
+}
 int opt_f (char* arg, size_t len, const char* prefix, float* var) {
     if (0==strncmp(arg, prefix, len)) {
         sscanf(arg+len, "%f", var);
@@ -413,6 +54,13 @@ int opt_f (char* arg, size_t len, const char* prefix, float* var) {
     }
     return 0;
 }
+int opt_s (char* arg, size_t len, const char* prefix, const char** var) {
+    if (0==strncmp(arg, prefix, len)) {
+        *var = arg+len;
+        return 1;
+    }
+    return 0;
+}
 int opt_b (char* arg, const char* opt, int* var) {
     if (0==strcmp(arg, opt)) {
         *var = 1;
@@ -428,6 +76,69 @@ int opt_nb (char* arg, const char* opt, int* var) {
     return 0;
 }
 
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void run_headless (Board* b) {
+    double start = now();
+    long long done = 0;
+    stats_record(b);
+    period_update(b);
+    record_start(b);
+    record_frame(b);
+    while (done < gens) {
+        long long n = gens - done;
+        if (period_on) {
+             // Engines that don't swap are hashed after each call, so they
+             // go a generation at a time; the rest are hashed as they swap
+             // and only need stopping now and then to see if they've settled.
+             // Stripes swap in their own processes, out of sight.
+            long long most = engine->step != hashlife_step && engine->step != infinite_step && procs <= 1 ? 64 : 1;
+            if (n > most) n = most;
+        }
+        if (checkpoint_every > 0 && n > checkpoint_every - done % checkpoint_every) {
+            n = checkpoint_every - done % checkpoint_every;
+        }
+        if (stats_on && n > stats_every - done % stats_every) n = stats_every - done % stats_every;
+        if (record_dir && n > record_every - done % record_every) n = record_every - done % record_every;
+        done += n;
+        int checkpoint_due = checkpoint_filename && checkpoint_every > 0 && (done % checkpoint_every == 0 || done == gens);
+        int stats_due = stats_on && (done % stats_every == 0 || done == gens);
+        int record_due = record_dir && done % record_every == 0;
+        double t = now();
+         // Stripes are only copied back when something's going to look at
+         // the board.
+        if (procs > 1) run_stripes(b, n, checkpoint_due || stats_due || record_due || period_on || done == gens);
+        else engine->step(b, n);
+        stats_time(STATS_STEP, t);
+        if (checkpoint_due) {
+            t = now();
+            checkpoint(b, checkpoint_filename);
+            stats_time(STATS_IO, t);
+        }
+        if (stats_due) stats_record(b);
+        if (record_due) record_frame(b);
+        period_update(b);
+        if (stop_on_stable && b->period) break;
+    }
+    if (procs > 1) end_stripes(b);
+    double secs = now() - start;
+    record_finish();
+    double cells = (double)b->width * b->height * done;
+    printf("%lld generations of %dx%d in %.3fs (%.3f Gcells/s, %s engine, %s kernel, %d threads)\n",
+        done, b->width, b->height, secs, secs > 0 ? cells / secs / 1e9 : 0,
+        engine->name, kernel->name, threads
+    );
+    printf("Population: %llu\n", (unsigned long long)engine->population(b));
+    if (engine->report) engine->report(b);
+    if (period_on) period_report(b);
+    if (census_on) census_report(b);
+    if (save_filename) save_snapshot(b, save_filename);
+}
+
 int main (int argc, char** argv) {
     const char* filename = NULL;
     seed = time(0);
@@ -441,9 +152,49 @@ int main (int argc, char** argv) {
         if (opt_nb(argv[i], "-no-wrap", &wrap)) continue;
         if (opt_b(argv[i], "-fs", &fullscreen)) continue;
         if (opt_b(argv[i], "-trails", &trails)) continue;
+        if (opt_b(argv[i], "-packed", &packed)) continue;
+        if (opt_s(argv[i], 7, "-stamp=", &stamp_filename)) continue;
         if (opt_f(argv[i], 5, "-fps=", &fps)) continue;
+        if (opt_b(argv[i], "-turbo", &turbo)) continue;
+        if (opt_f(argv[i], 10, "-frame-ms=", &frame_ms)) continue;
         if (opt_i(argv[i], 6, "-seed=", &seed)) continue;
-        if (argv[i][0] == '-') {
+        if (opt_f(argv[i], 9, "-density=", &density)) continue;
+        if (opt_b(argv[i], "-headless", &headless)) continue;
+        if (opt_ll(argv[i], 6, "-gens=", &gens)) continue;
+        if (opt_i(argv[i], 10, "-ensemble=", &ensemble)) continue;
+        if (opt_s(argv[i], 8, "-kernel=", &kernel_name)) continue;
+        if (opt_i(argv[i], 9, "-threads=", &nthreads)) continue;
+        if (opt_s(argv[i], 8, "-engine=", &engine_name)) continue;
+        if (opt_ll(argv[i], 12, "-block-gens=", &block_gens)) continue;
+        if (opt_i(argv[i], 7, "-procs=", &procs)) continue;
+        if (opt_s(argv[i], 6, "-halo=", &halo_transport)) continue;
+        if (opt_s(argv[i], 6, "-rule=", &rule_name)) continue;
+        if (opt_ll(argv[i], 14, "-hashlife-mem=", &hashlife_mem)) continue;
+        if (opt_ll(argv[i], 9, "-history=", &history_depth)) continue;
+        if (opt_ll(argv[i], 13, "-history-mem=", &history_mem)) continue;
+        if (opt_s(argv[i], 6, "-save=", &save_filename)) continue;
+        if (opt_s(argv[i], 12, "-checkpoint=", &checkpoint_filename)) continue;
+        if (opt_ll(argv[i], 18, "-checkpoint-every=", &checkpoint_every)) continue;
+        if (opt_s(argv[i], 7, "-stats=", &stats_filename)) continue;
+        if (opt_b(argv[i], "-period", &period_on)) continue;
+        if (opt_s(argv[i], 8, "-record=", &record_dir)) continue;
+        if (opt_ll(argv[i], 14, "-record-every=", &record_every)) continue;
+        if (opt_i(argv[i], 14, "-record-scale=", &record_scale)) continue;
+        if (opt_i(argv[i], 16, "-record-threads=", &record_threads)) continue;
+        if (opt_i(argv[i], 14, "-record-queue=", &record_queue)) continue;
+        if (0==strncmp(argv[i], "-record-region=", 15)) {
+            if (sscanf(argv[i] + 15, "%d,%d,%d,%d", &record_x, &record_y, &record_w, &record_h) != 4) {
+                fprintf(stderr, "-record-region= takes x,y,width,height.\n");
+                exit(1);
+            }
+            continue;
+        }
+        if (opt_b(argv[i], "-stop-on-stable", &stop_on_stable)) continue;
+        if (opt_b(argv[i], "-census", &census_on)) continue;
+        if (opt_s(argv[i], 8, "-script=", &script_filename)) continue;
+        if (opt_ll(argv[i], 13, "-stats-every=", &stats_every)) continue;
+        if (opt_s(argv[i], 11, "-stats-shm=", &stats_shm_name)) continue;
+        if (argv[i][0] == '-' && argv[i][1]) {
             if (argv[i][1] == '-')
                 break;
             else {
@@ -453,185 +204,61 @@ int main (int argc, char** argv) {
         }
         filename = argv[i];
     }
-    srand(seed);
-    glfwInit();
-    glfwOpenWindow(window_width, window_height, 8, 8, 8, 0, 0, 0, fullscreen ? GLFW_FULLSCREEN : GLFW_WINDOW);
-    glfwEnable(GLFW_MOUSE_CURSOR);
-    glfwDisable(GLFW_AUTO_POLL_EVENTS);
-    glfwSetWindowCloseCallback(close_cb);
-    glfwSetWindowSizeCallback(resize_cb);
-    glfwSetKeyCallback(key_cb);
-    glfwSetMouseButtonCallback(button_cb);
-    glfwSetMousePosCallback(motion_cb);
-    GLenum err = glewInit();
-    if (err != GLEW_OK) {
-        fprintf(stderr, "GLEW error: %s\n", glewGetErrorString(err));
+    if (hashlife_mem < 1) {
+        fprintf(stderr, "-hashlife-mem= must be at least 1.\n");
         exit(1);
     }
-    GLint status;
-    GLint loglen;
-    GLuint vsid = glCreateShader(GL_VERTEX_SHADER);
-    int vslen = strlen(vssrc);
-    glShaderSource(vsid, 1, &vssrc, &vslen);
-    glCompileShader(vsid);
-    glGetShaderiv(vsid, GL_COMPILE_STATUS, &status);
-    glGetShaderiv(vsid, GL_INFO_LOG_LENGTH, &loglen);
-    if (!status || loglen > 1) {
-        char log [loglen];
-        glGetShaderInfoLog(vsid, loglen, NULL, log);
-        fprintf(stderr, "Shader info log for vertex shader:\n");
-        fputs(log, stderr);
-        if (!status) {
-            fprintf(stderr, "Failed to compile GL shader.\n");
-            exit(1);
-        }
-    }
-    glerr("after compiling vertex shader");
-    GLuint fsid = glCreateShader(GL_FRAGMENT_SHADER);
-    int fslen = strlen(fssrc);
-    glShaderSource(fsid, 1, &fssrc, &fslen);
-    glCompileShader(fsid);
-    glGetShaderiv(fsid, GL_COMPILE_STATUS, &status);
-    glGetShaderiv(fsid, GL_INFO_LOG_LENGTH, &loglen);
-    if (!status || loglen > 1) {
-        char log [loglen];
-        glGetShaderInfoLog(fsid, loglen, NULL, log);
-        fprintf(stderr, "Shader info log for fragment shader:\n");
-        fputs(log, stderr);
-        if (!status) {
-            fprintf(stderr, "Failed to compile GL shader.\n");
-            exit(1);
-        }
-    }
-    glerr("after compiling fragment shader");
-
-    GLuint prid = glCreateProgram();
-    glAttachShader(prid, vsid);
-    glAttachShader(prid, fsid);
-    glLinkProgram(prid);
-    glGetProgramiv(prid, GL_LINK_STATUS, &status);
-    glGetProgramiv(prid, GL_INFO_LOG_LENGTH, &loglen);
-    if (!status || loglen > 1) {
-        char log [loglen];
-        glGetProgramInfoLog(prid, loglen, NULL, log);
-        fprintf(stderr, "Program info log:\n");
-        fputs(log, stderr);
-        if (!status) {
-            fprintf(stderr, "Failed to link GL program.\n");
-            exit(1);
-        }
-    }
-    glerr("after linking program");
-    glUseProgram(prid);
-
-    GLint uni_tex = glGetUniformLocation(prid, "tex");
-    GLint uni_tex_size = glGetUniformLocation(prid, "tex_size");
-    GLint uni_do_calc = glGetUniformLocation(prid, "do_calc");
-    GLint uni_rewind = glGetUniformLocation(prid, "rewind");
-    GLint uni_trails = glGetUniformLocation(prid, "trails");
-    glUniform1i(uni_tex, 0);
-    glUniform2f(uni_tex_size, width, height);
-    glUniform1i(uni_trails, trails);
-    glerr("after getting uniforms");
-
-    glGenTextures(1, &tex1);
-    glBindTexture(GL_TEXTURE_2D, tex1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    if (!wrap) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glerr("after creating tex 1");
-    glGenFramebuffers(1, &fb1);
-    glBindFramebuffer(GL_FRAMEBUFFER, fb1);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex1, 0);
-    glerr("after creating fb 1");
-    GLenum fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
-        fprintf(stderr, "Framebuffer 1 creation failed: 0x%04X\n", fb_status);
+    if (history_mem < 0) {
+        fprintf(stderr, "-history-mem= can't be negative.\n");
         exit(1);
     }
-
-    glGenTextures(1, &tex2);
-    glBindTexture(GL_TEXTURE_2D, tex2);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    if (!wrap) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    select_kernel(kernel_name);
+    start_threads(nthreads);
+    select_engine(engine_name);
+    if (rule_name) {
+        select_rule(rule_name);
+        rule_fixed = 1;
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glerr("after creating tex 2");
-    glGenFramebuffers(1, &fb2);
-    glBindFramebuffer(GL_FRAMEBUFFER, fb2);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex2, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glerr("after creating fb 2");
-    fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
-        fprintf(stderr, "Framebuffer 2 creation failed: 0x%04X\n", fb_status);
-        exit(1);
+    if (ensemble) {
+        run_ensemble(ensemble, seed, gens);
+        return 0;
     }
-
-    glBindTexture(GL_TEXTURE_2D, tex1);
-    if (filename) {
-        read_rle(filename);
+    stats_open();
+    if (stop_on_stable) period_on = 1;
+    Board* b;
+    double load_start = now();
+    if (filename && 0!=strcmp(filename, "-") && is_snapshot(filename)) {
+         // The snapshot decides the board's size and edges.
+        char saved_rule [64];
+        b = load_snapshot(filename, saved_rule, sizeof saved_rule);
+        if (!rule_fixed && saved_rule[0]) select_rule(saved_rule);
+        width = b->width;
+        height = b->height;
+        wrap = b->wrap;
     }
     else {
-        randomize();
-    }
-
-    float verts [8] = { 0, 0,  1, 0,  1, 1,  0, 1 };
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, verts);
-
-    int first_frame = 1;
-    while (!exiting) {
-        if (rewind_frame) {
-            if (rewound < 8) {
-                glUniform1i(uni_rewind, 1);
-                glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
-                glBindFramebuffer(GL_FRAMEBUFFER, use2 ? fb1 : fb2);
-                glViewport(0, 0, width, height);
-                glDrawArrays(GL_QUADS, 0, 4);
-                use2 = !use2;
-                glUniform1i(uni_rewind, 0);
-                rewound += 1;
-            }
-            rewind_frame = 0;
-        }
-        else if (!first_frame && (!paused || advance_frame)) {
-            if (rewound > 0) rewound--;
-             // Run a step
-            glUniform1i(uni_do_calc, 1);
-            glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
-            glBindFramebuffer(GL_FRAMEBUFFER, use2 ? fb1 : fb2);
-            glViewport(0, 0, width, height);
-            glDrawArrays(GL_QUADS, 0, 4);
-             // Switch buffer
-            use2 = !use2;
-        }
-        first_frame = 0;
-        advance_frame = 0;
-         // Copy to window
-        glUniform1i(uni_do_calc, 0);
-        glBindTexture(GL_TEXTURE_2D, use2 ? tex2 : tex1);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, window_width, window_height);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glerr("after doing a render");
-        glfwSwapBuffers();
-        if (!paused) {
-            glfwSleep(1/fps);
-            glfwPollEvents();
+        b = board_new(width, height, wrap);
+        if (filename) {
+            read_rle(b, filename, NULL);
         }
         else {
-            glfwWaitEvents();
+            board_randomize(b);
         }
     }
+    if (filename) stats_time(STATS_IO, load_start);
+    check_rule_engine();
+    if (script_filename) {
+        b = run_script(b);
+    }
+    else if (headless) {
+        run_headless(b);
+    }
+#ifndef NO_DISPLAY
+    else {
+        run_display(b);
+    }
+#endif
+    stats_close();
+    board_free(b);
     return 0;
 }
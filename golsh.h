@@ -0,0 +1,327 @@
+#ifndef GOLSH_H
+#define GOLSH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+ // Options shared between the simulation and the display
+extern int width;
+extern int height;
+extern int window_width;
+extern int window_height;
+extern int fullscreen;
+extern int paused;
+extern int seed;
+extern float fps;
+extern int wrap;
+extern int trails;
+extern int packed;
+
+ // Counters for one generation, see stats.c
+typedef struct StepStats {
+    uint64_t generation;  // The one these describe
+    uint64_t edits;  // The board's edits when they were counted
+    uint64_t population;
+    uint64_t births;  // Only known if counted
+    uint64_t deaths;
+    int64_t xmin, ymin, xmax, ymax;  // Bounding box of live cells, empty if xmin > xmax
+    uint64_t tiles;  // Tiles stepped
+    int counted;  // Counted while stepping rather than scanned afterwards
+} StepStats;
+
+ // A board stores 64 cells per word, with bit k of word j in a row being
+ // cell 64*j + k.  Rows are stored bottom to top like the GL texture.
+typedef struct Board {
+    int width;
+    int height;
+    int wrap;
+    int words;  // Words per row
+    uint64_t tail;  // Mask of the valid bits in the last word of a row
+    uint64_t* cells;
+    uint64_t* next;
+    uint64_t* zero;  // A row of dead cells for beyond the edges
+    uint64_t generation;
+    uint64_t edits;  // Bumped whenever cells are changed other than by stepping
+    int age_planes;
+    uint64_t* ages;  // Bit planes counting down the steps left to dying cells
+    StepStats stats;  // Of the current generation, when stats_on
+    StepStats stats_next;  // Being added up by the tiles of the next
+    uint64_t hash;  // Of the cells at hash_generation, when period_on
+    uint64_t hash_delta;  // What stepping has changed it by so far
+    uint64_t hash_generation;
+    uint64_t hash_edits;
+    int hash_valid;
+    uint64_t period;  // Once a state repeats, 1 for still lifes
+    uint64_t period_start;  // The generation the cycle began
+} Board;
+
+uint64_t* alloc_words (size_t n);
+Board* board_new (int width, int height, int wrap);
+void board_free (Board* b);
+int board_get (const Board* b, int x, int y);
+void board_set (Board* b, int x, int y, int val);
+void board_fill (Board* b, int x, int y, int len, int val);
+void board_clear (Board* b);
+extern float density;
+void board_randomize (Board* b);
+uint64_t board_population (const Board* b);
+void board_step (Board* b, uint64_t gens);
+void board_swap (Board* b);
+void step_tile (Board* b, int y0, int y1, int j0, int j1);
+void board_ensure_ages (Board* b);
+void board_set_age (Board* b, int x, int y, int age);
+int board_get_age (const Board* b, int x, int y);
+
+ // Life-like rules with kernels of their own, so their rule folds into the
+ // logic at compile time.  Every other rule of radius 1 uses RULE_GENERIC.
+enum {RULE_LIFE, RULE_HIGHLIFE, RULE_DAY_NIGHT, RULE_SEEDS, RULE_GENERIC, RULE_KERNELS};
+#define RULE_MAX_RADIUS 32
+#define RULE_MAX_COUNT ((2 * RULE_MAX_RADIUS + 1) * (2 * RULE_MAX_RADIUS + 1))
+typedef struct Rule {
+    char name [64];
+    int radius;  // More than 1 for Larger than Life
+    int middle;  // Whether a cell counts itself among its neighbors
+    int states;  // More than 2 for Generations
+    uint32_t birth_mask;  // Bit n set if n neighbors give birth, for radius 1
+    uint32_t survive_mask;
+    int kernel;  // RULE_ kernel for radius 1
+    unsigned char birth [RULE_MAX_COUNT + 1];  // By neighbor count
+    unsigned char survive [RULE_MAX_COUNT + 1];
+} Rule;
+extern Rule rule;
+extern int rule_fixed;  // Set when given on the command line, so files don't override it
+int parse_rule (const char* s, Rule* r, char* err, size_t errlen);
+void select_rule (const char* s);
+void check_rule_engine ();
+void ltl_tile (Board* b, int y0, int y1, int j0, int j1);
+
+extern int threads;
+void start_threads (int n);
+void threaded_step (Board* b, uint64_t gens);
+typedef void (*RowJob) (Board* b, int y0, int y1, void* arg);
+void threaded_rows (Board* b, RowJob fn, void* arg);
+
+ // Computes the next generation of the word m from the word above (u) and
+ // the word below (d), each with its west and east neighbors shifted into
+ // place.  The eight neighbor bits are summed with full adders into ones,
+ // twos and fours bit planes; a count of 8 wraps to 0, which is harmless
+ // since neither 8 nor 0 is a 2 or a 3.  This is a macro so that the same
+ // logic can be used on plain words and on GCC vectors of words.
+#define LIFE_WORD(UW, U, UE, MW, M, ME, DW, D, DE) ({ \
+    typeof(M) _uw = (UW), _u = (U), _ue = (UE); \
+    typeof(M) _mw = (MW), _m = (M), _me = (ME); \
+    typeof(M) _dw = (DW), _d = (D), _de = (DE); \
+    typeof(M) _s1 = _uw ^ _u ^ _ue; \
+    typeof(M) _c1 = (_uw & _u) | (_ue & (_uw ^ _u)); \
+    typeof(M) _s2 = _mw ^ _me ^ _dw; \
+    typeof(M) _c2 = (_mw & _me) | (_dw & (_mw ^ _me)); \
+    typeof(M) _s3 = _d ^ _de; \
+    typeof(M) _c3 = _d & _de; \
+    typeof(M) _ones = _s1 ^ _s2 ^ _s3; \
+    typeof(M) _k = (_s1 & _s2) | (_s3 & (_s1 ^ _s2)); \
+    typeof(M) _t = _c1 ^ _c2 ^ _c3; \
+    typeof(M) _f1 = (_c1 & _c2) | (_c3 & (_c1 ^ _c2)); \
+    typeof(M) _twos = _t ^ _k; \
+    typeof(M) _fours = _f1 ^ (_t & _k); \
+    _twos & ~_fours & (_ones | _m); \
+})
+
+ // Like LIFE_WORD but for any Life-like rule, given as masks of the neighbor
+ // counts that give birth and survival.  The count gets an eights plane so
+ // that 8 and 0 differ, and each count from 0 to 8 contributes a term that
+ // is zero unless its bit is set in one of the masks.  When the masks are
+ // constants the unused terms fold away at compile time.
+#define RULE_WORD(UW, U, UE, MW, M, ME, DW, D, DE, BIRTH, SURVIVE) ({ \
+    typeof(M) _uw = (UW), _u = (U), _ue = (UE); \
+    typeof(M) _mw = (MW), _m = (M), _me = (ME); \
+    typeof(M) _dw = (DW), _d = (D), _de = (DE); \
+    typeof(M) _s1 = _uw ^ _u ^ _ue; \
+    typeof(M) _c1 = (_uw & _u) | (_ue & (_uw ^ _u)); \
+    typeof(M) _s2 = _mw ^ _me ^ _dw; \
+    typeof(M) _c2 = (_mw & _me) | (_dw & (_mw ^ _me)); \
+    typeof(M) _s3 = _d ^ _de; \
+    typeof(M) _c3 = _d & _de; \
+    typeof(M) _ones = _s1 ^ _s2 ^ _s3; \
+    typeof(M) _k = (_s1 & _s2) | (_s3 & (_s1 ^ _s2)); \
+    typeof(M) _t = _c1 ^ _c2 ^ _c3; \
+    typeof(M) _f1 = (_c1 & _c2) | (_c3 & (_c1 ^ _c2)); \
+    typeof(M) _twos = _t ^ _k; \
+    typeof(M) _fours = _f1 ^ (_t & _k); \
+    typeof(M) _eights = _f1 & _t & _k; \
+    uint64_t _birth = (BIRTH), _survive = (SURVIVE); \
+    RULE_TERM(0) | RULE_TERM(1) | RULE_TERM(2) | RULE_TERM(3) | RULE_TERM(4) \
+  | RULE_TERM(5) | RULE_TERM(6) | RULE_TERM(7) | RULE_TERM(8); \
+})
+#define RULE_TERM(C) ( \
+    (_ones ^ (uint64_t)(((C) & 1) - 1)) & (_twos ^ (uint64_t)(((C) >> 1 & 1) - 1)) \
+  & (_fours ^ (uint64_t)(((C) >> 2 & 1) - 1)) & (_eights ^ (uint64_t)(((C) >> 3 & 1) - 1)) \
+  & ((~_m & -(_birth >> (C) & 1)) | (_m & -(_survive >> (C) & 1))) \
+)
+
+typedef void (*StepSpan) (
+    const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+    uint64_t* out, int j0, int j1
+);
+typedef struct Kernel {
+    const char* name;
+    StepSpan spans [RULE_KERNELS];  // By RULE_ kernel
+} Kernel;
+extern Kernel kernels [];  // Ending with a NULL name
+extern const Kernel* kernel;
+int kernel_supported (const Kernel* k);
+void select_kernel (const char* name);
+void step_row (
+    const Board* b, const uint64_t* up, const uint64_t* mid,
+    const uint64_t* down, uint64_t* out, int j0, int j1
+);
+ // Width in words of the column strips stepped at a time
+#define STEP_BLOCK_WORDS 512
+
+typedef struct Engine {
+    const char* name;
+    void (*step) (Board* b, uint64_t gens);
+    uint64_t (*population) (Board* b);
+    void (*report) (Board* b);  // Prints engine-specific stats, may be NULL
+} Engine;
+extern const Engine* engine;
+void select_engine (const char* name);
+
+extern long long hashlife_mem;
+void hashlife_step (Board* b, uint64_t gens);
+uint64_t hashlife_population (Board* b);
+void hashlife_report (Board* b);
+
+void infinite_step (Board* b, uint64_t gens);
+uint64_t infinite_population (Board* b);
+void infinite_report (Board* b);
+
+extern long long block_gens;
+void blocked_step (Board* b, uint64_t gens);
+
+extern const char* packed_glsl;
+void packed_step (Board* b, uint64_t gens);
+
+void sparse_step (Board* b, uint64_t gens);
+void sparse_report (Board* b);
+double sparse_active_fraction ();
+
+typedef struct RleInfo {
+    int64_t width;  // From the x = and y = header
+    int64_t height;
+    int64_t pos_x;  // From #CXRLE Pos=, if has_pos
+    int64_t pos_y;
+    int has_pos;
+    char rule [64];
+} RleInfo;
+int parse_rle (Board* b, const char* data, size_t len, RleInfo* info, char* err, size_t errlen);
+void read_rle (Board* b, const char* filename, RleInfo* info);
+Board* read_pattern (const char* filename);
+
+int is_snapshot (const char* filename);
+Board* load_snapshot (const char* filename, char* rule_name, size_t rulelen);
+void save_snapshot (Board* b, const char* filename);
+void checkpoint (Board* b, const char* filename);
+
+extern long long history_depth;
+extern long long history_mem;
+void history_reset (Board* b);
+void history_record (Board* b);
+int history_back (Board* b);
+int history_forward (Board* b);
+void history_seek (Board* b, uint64_t generation);
+void history_range (uint64_t* oldest, uint64_t* newest);
+
+double now ();
+
+ // The block a -stats-shm= name maps to.  Writers make seq odd while they
+ // fill it in, so a reader copies it out and keeps the copy only if seq was
+ // even and the same before and after.
+#define STATS_MAGIC 0x5354415453484c47ull
+#define STATS_VERSION 1
+typedef struct SharedStats {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint64_t seq;
+    uint64_t generation;
+    uint64_t population;
+    uint64_t births;
+    uint64_t deaths;
+    int64_t xmin, ymin, xmax, ymax;  // Empty if xmin > xmax
+    uint64_t tiles;
+    uint64_t step_ns;  // Totals since the start
+    uint64_t render_ns;
+    uint64_t io_ns;
+    uint32_t counted;  // Whether births and deaths are known
+    uint32_t pad;
+} SharedStats;
+enum {STATS_STEP, STATS_RENDER, STATS_IO, STATS_TIMERS};
+extern int stats_on;
+extern const char* stats_filename;
+extern long long stats_every;
+extern const char* stats_shm_name;
+extern uint64_t stats_ns [STATS_TIMERS];
+void stats_clear (StepStats* s);
+void tile_stats (Board* b, int y0, int y1, int j0, int j1);
+void stats_latch (Board* b);
+void stats_open ();
+void stats_close ();
+void stats_time (int which, double start);
+void stats_record (Board* b);
+
+extern const char* record_dir;
+extern long long record_every;
+extern int record_x, record_y, record_w, record_h;
+extern int record_scale;
+extern int record_threads;
+extern int record_queue;
+void record_start (const Board* b);
+void record_frame (const Board* b);
+void record_finish ();
+
+extern int period_on;
+extern int stop_on_stable;
+uint64_t board_hash (const Board* b);
+uint64_t hash_delta (const uint64_t* in, const uint64_t* out, uint64_t at, int n);
+void tile_hash (Board* b, int y0, int y1, int j0, int j1);
+void period_between (Board* b, const uint64_t* deltas, int n);
+void period_latch (Board* b);
+void period_update (Board* b);
+void period_report (Board* b);
+
+extern int census_on;
+void census_report (Board* b);
+
+extern int turbo;
+extern float frame_ms;
+extern double sim_gens_per_sec;
+void sim_start (Board* b, int paused);
+void sim_stop ();
+void sim_pause (int paused);
+void sim_lock ();
+void sim_unlock ();
+int sim_frame (const uint64_t** cells, uint64_t* generation);
+
+void run_ensemble (int n, uint64_t seed, uint64_t gens);
+
+void brush_line (const Board* b, int x0, int y0, int x1, int y1, int val);
+void brush_stamp (const Board* b, const Board* pattern, int x, int y);
+int brush_dirty ();
+int brush_apply (Board* b, int* x0, int* y0, int* x1, int* y1);
+
+#define MIP_BASE 8
+void mip_update (const uint64_t* cells, int width, int height, int words);
+void mip_render (unsigned char* out, int pw, int ph, double x0, double y0, double sx, double sy);
+
+extern const char* script_filename;
+Board* run_script (Board* b);
+
+extern int procs;
+extern const char* halo_transport;
+void run_stripes (Board* b, uint64_t gens, int gather);
+void end_stripes (Board* b);
+
+extern const char* stamp_filename;
+void run_display (Board* b);
+
+#endif
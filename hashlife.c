@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // A quadtree of canonical nodes, where each distinct square of cells exists
+ // only once.  Leaves are 8x8 squares (level 3) stored as a word with cell
+ // (x, y) in bit y*8 + x.  Children are in the order (low x, low y),
+ // (high x, low y), (low x, high y), (high x, high y).  The universe is
+ // unbounded, so the board's wrap setting doesn't apply; the board is a
+ // window onto it with its lower-left corner at the origin.
+typedef struct Node {
+    struct Node* child [4];
+    struct Node* next;  // Next in hash chain or free list
+    struct Node* result;  // Center after 2^result_step generations
+    uint64_t pop;
+    uint64_t bits;
+    int level;
+    int result_step;
+    uint32_t mark;
+} Node;
+
+#define LEAF_LEVEL 3
+#define MAX_LEVEL 62  // So the universe's size, 1 << level, fits an int64_t
+#define NODES_PER_BLOCK 4096
+
+long long hashlife_mem = 1024;  // In MB
+
+Node** buckets;
+size_t nbuckets;
+size_t nnodes;
+size_t node_limit;
+Node* free_nodes;
+Node* empty [MAX_LEVEL + 1];
+Node* root;
+uint32_t gc_epoch;
+uint32_t memo_birth, memo_survive;  // The rule the memoized results follow
+uint64_t synced_edits = -1;
+uint64_t synced_generation;
+Board* synced_board;
+uint64_t* synced_cells;  // The window as the universe last had it
+int synced_width, synced_height;
+
+ // Nodes that are in use by a computation in progress, and so must survive
+ // garbage collection even though nothing points to them yet.
+Node** kept;
+size_t nkept;
+size_t kept_cap;
+
+static Node* keep (Node* n) {
+    if (nkept == kept_cap) {
+        kept_cap = kept_cap ? kept_cap * 2 : 1024;
+        kept = realloc(kept, kept_cap * sizeof(Node*));
+    }
+    kept[nkept++] = n;
+    return n;
+}
+
+static void mark (Node* n) {
+    while (n->mark != gc_epoch) {
+        n->mark = gc_epoch;
+        if (n->level == LEAF_LEVEL) return;
+        mark(n->child[0]);
+        mark(n->child[1]);
+        mark(n->child[2]);
+        n = n->child[3];
+    }
+}
+
+ // Frees every node not reachable from the root, the kept stack or the
+ // empty nodes.  Memoized results pointing at freed nodes are forgotten.
+static void collect () {
+    size_t i;
+    int k;
+    gc_epoch++;
+    if (root) mark(root);
+    for (i = 0; i < nkept; i++) mark(kept[i]);
+    for (k = LEAF_LEVEL; k <= MAX_LEVEL && empty[k]; k++) mark(empty[k]);
+    for (i = 0; i < nbuckets; i++) {
+        Node* n;
+        for (n = buckets[i]; n; n = n->next) {
+            if (n->mark == gc_epoch && n->result && n->result->mark != gc_epoch)
+                n->result = NULL;
+        }
+    }
+    for (i = 0; i < nbuckets; i++) {
+        Node** p = &buckets[i];
+        while (*p) {
+            Node* n = *p;
+            if (n->mark == gc_epoch) {
+                p = &n->next;
+            }
+            else {
+                *p = n->next;
+                n->next = free_nodes;
+                free_nodes = n;
+                nnodes--;
+            }
+        }
+    }
+    if (nnodes > node_limit / 2) {
+         // Live nodes alone are taking up most of the budget, so go over it
+         // rather than collect again on every allocation.
+        fprintf(stderr, "HashLife: %zu live nodes exceed half the %lluMB budget.\n",
+            nnodes, (unsigned long long)hashlife_mem
+        );
+        node_limit = nnodes * 2;
+    }
+}
+
+static Node* alloc_node () {
+    if (!free_nodes) {
+        Node* block = malloc(NODES_PER_BLOCK * sizeof(Node));
+        if (!block) {
+            fprintf(stderr, "Out of memory allocating HashLife nodes.\n");
+            exit(1);
+        }
+        int i;
+        for (i = 0; i < NODES_PER_BLOCK; i++) {
+            block[i].next = free_nodes;
+            free_nodes = &block[i];
+        }
+    }
+    Node* n = free_nodes;
+    free_nodes = n->next;
+    nnodes++;
+    return n;
+}
+
+static size_t mix (uint64_t h) {
+    h = (h ^ h >> 30) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ h >> 27) * 0x94D049BB133111EBull;
+    return h ^ h >> 31;
+}
+static size_t hash_children (Node* a, Node* b, Node* c, Node* d) {
+    return mix((size_t)a + 3 * (size_t)b + 5 * (size_t)c + 7 * (size_t)d);
+}
+static size_t hash_bits (uint64_t bits) {
+    return mix(bits);
+}
+
+static void grow_buckets () {
+    size_t newn = nbuckets ? nbuckets * 2 : 1 << 16;
+    Node** newb = calloc(newn, sizeof(Node*));
+    size_t i;
+    for (i = 0; i < nbuckets; i++) {
+        Node* n = buckets[i];
+        while (n) {
+            Node* next = n->next;
+            size_t h = n->level == LEAF_LEVEL
+                ? hash_bits(n->bits)
+                : hash_children(n->child[0], n->child[1], n->child[2], n->child[3]);
+            n->next = newb[h & (newn - 1)];
+            newb[h & (newn - 1)] = n;
+            n = next;
+        }
+    }
+    free(buckets);
+    buckets = newb;
+    nbuckets = newn;
+}
+
+ // Collection happens before searching, so that the children (which the
+ // caller must have kept) are never freed out from under us.
+static void make_room () {
+    if (!node_limit) node_limit = hashlife_mem * 1024 * 1024 / (sizeof(Node) + sizeof(Node*));
+    if (nnodes >= node_limit) collect();
+    if (nnodes >= nbuckets) grow_buckets();
+}
+
+static Node* leaf (uint64_t bits) {
+    make_room();
+    size_t h = hash_bits(bits) & (nbuckets - 1);
+    Node* n;
+    for (n = buckets[h]; n; n = n->next) {
+        if (n->level == LEAF_LEVEL && n->bits == bits) return n;
+    }
+    n = alloc_node();
+    memset(n, 0, sizeof(Node));
+    n->level = LEAF_LEVEL;
+    n->bits = bits;
+    n->pop = __builtin_popcountll(bits);
+    n->next = buckets[h];
+    buckets[h] = n;
+    return n;
+}
+
+static Node* node (Node* a, Node* b, Node* c, Node* d) {
+    make_room();
+    size_t h = hash_children(a, b, c, d) & (nbuckets - 1);
+    Node* n;
+    for (n = buckets[h]; n; n = n->next) {
+        if (n->child[0] == a && n->child[1] == b && n->child[2] == c && n->child[3] == d)
+            return n;
+    }
+    n = alloc_node();
+    memset(n, 0, sizeof(Node));
+    n->child[0] = a;
+    n->child[1] = b;
+    n->child[2] = c;
+    n->child[3] = d;
+    n->level = a->level + 1;
+    n->pop = a->pop + b->pop + c->pop + d->pop;
+    n->next = buckets[h];
+    buckets[h] = n;
+    return n;
+}
+
+static Node* empty_node (int level) {
+    if (!empty[level]) {
+        empty[level] = level == LEAF_LEVEL ? leaf(0) : node(
+            empty_node(level - 1), empty_node(level - 1),
+            empty_node(level - 1), empty_node(level - 1)
+        );
+    }
+    return empty[level];
+}
+
+ // Steps a 16x16 square (a level 4 node) by brute force, returning its
+ // center 8x8 after up to 4 generations.
+static Node* step_base (Node* n, int gens) {
+    uint32_t rows [18] = {0};
+    int y, g;
+    for (y = 0; y < 8; y++) {
+        rows[y + 1] = (n->child[0]->bits >> (y * 8) & 0xff)
+                    | (n->child[1]->bits >> (y * 8) & 0xff) << 8;
+        rows[y + 9] = (n->child[2]->bits >> (y * 8) & 0xff)
+                    | (n->child[3]->bits >> (y * 8) & 0xff) << 8;
+    }
+    for (g = 0; g < gens; g++) {
+        uint32_t next [18] = {0};
+        for (y = 1; y <= 16; y++) {
+            uint32_t u = rows[y + 1], m = rows[y], d = rows[y - 1];
+            next[y] = RULE_WORD(
+                u << 1, u, u >> 1,
+                m << 1, m, m >> 1,
+                d << 1, d, d >> 1,
+                rule.birth_mask, rule.survive_mask
+            ) & 0xffff;
+        }
+        memcpy(rows, next, sizeof rows);
+    }
+    uint64_t bits = 0;
+    for (y = 0; y < 8; y++) {
+        bits |= (uint64_t)(rows[y + 5] >> 4 & 0xff) << (y * 8);
+    }
+    return leaf(bits);
+}
+
+ // The center half of a node, one level down.
+static Node* center (Node* n) {
+    if (n->level == LEAF_LEVEL + 1) {
+        uint64_t bits = 0;
+        int y;
+        for (y = 0; y < 4; y++) {
+            bits |= (n->child[0]->bits >> ((y + 4) * 8 + 4) & 0xf) << (y * 8);
+            bits |= (n->child[1]->bits >> ((y + 4) * 8) & 0xf) << (y * 8 + 4);
+            bits |= (n->child[2]->bits >> (y * 8 + 4) & 0xf) << ((y + 4) * 8);
+            bits |= (n->child[3]->bits >> (y * 8) & 0xf) << ((y + 4) * 8 + 4);
+        }
+        return leaf(bits);
+    }
+    return node(
+        n->child[0]->child[3], n->child[1]->child[2],
+        n->child[2]->child[1], n->child[3]->child[0]
+    );
+}
+
+ // Returns the center half of n advanced by 2^step generations, which must
+ // be at most 2^(level-2).  The nine overlapping subsquares of half size are
+ // advanced or just centered, then regrouped into four squares which are
+ // advanced again.
+static Node* step_node (Node* n, int step) {
+    if (n->result && n->result_step == step) return n->result;
+    if (n->pop == 0) return empty_node(n->level - 1);
+    size_t base = nkept;
+    Node* r;
+    if (n->level == LEAF_LEVEL + 1) {
+        r = step_base(n, 1 << step);
+    }
+    else {
+        Node* a = n->child[0];
+        Node* b = n->child[1];
+        Node* c = n->child[2];
+        Node* d = n->child[3];
+        Node* sub [9];
+        sub[0] = a;
+        sub[1] = keep(node(a->child[1], b->child[0], a->child[3], b->child[2]));
+        sub[2] = b;
+        sub[3] = keep(node(a->child[2], a->child[3], c->child[0], c->child[1]));
+        sub[4] = keep(node(a->child[3], b->child[2], c->child[1], d->child[0]));
+        sub[5] = keep(node(b->child[2], b->child[3], d->child[0], d->child[1]));
+        sub[6] = c;
+        sub[7] = keep(node(c->child[1], d->child[0], c->child[3], d->child[2]));
+        sub[8] = d;
+        int full = step == n->level - 2;
+        Node* s [9];
+        int i;
+        for (i = 0; i < 9; i++) {
+            s[i] = keep(full ? step_node(sub[i], n->level - 3) : center(sub[i]));
+        }
+        int next_step = full ? n->level - 3 : step;
+        Node* q0 = keep(node(s[0], s[1], s[3], s[4]));
+        Node* q1 = keep(node(s[1], s[2], s[4], s[5]));
+        Node* q2 = keep(node(s[3], s[4], s[6], s[7]));
+        Node* q3 = keep(node(s[4], s[5], s[7], s[8]));
+        Node* r0 = keep(step_node(q0, next_step));
+        Node* r1 = keep(step_node(q1, next_step));
+        Node* r2 = keep(step_node(q2, next_step));
+        Node* r3 = keep(step_node(q3, next_step));
+        r = node(r0, r1, r2, r3);
+    }
+    nkept = base;
+    n->result = r;
+    n->result_step = step;
+    return r;
+}
+
+ // Doubles the root's size around the same center.
+static Node* expand (Node* n) {
+    Node* e = empty_node(n->level - 1);
+    size_t base = nkept;
+    Node* a = keep(node(e, e, e, n->child[0]));
+    Node* b = keep(node(e, e, n->child[1], e));
+    Node* c = keep(node(e, n->child[2], e, e));
+    Node* d = keep(node(n->child[3], e, e, e));
+    Node* r = node(a, b, c, d);
+    nkept = base;
+    return r;
+}
+
+static int centered (Node* n) {
+    return n->child[0]->child[3]->pop + n->child[1]->child[2]->pop
+         + n->child[2]->child[1]->pop + n->child[3]->child[0]->pop == n->pop;
+}
+
+static Node* build (Board* b, int64_t x0, int64_t y0, int level) {
+    if (x0 >= b->width || y0 >= b->height || x0 + ((int64_t)1 << level) <= 0 || y0 + ((int64_t)1 << level) <= 0)
+        return empty_node(level);
+    if (level == LEAF_LEVEL) {
+        uint64_t bits = 0;
+        int y;
+        for (y = 0; y < 8; y++) {
+            if (y0 + y < b->height) {
+                uint64_t w = b->cells[(size_t)(y0 + y) * b->words + x0 / 64];
+                bits |= (w >> (x0 % 64) & 0xff) << (y * 8);
+            }
+        }
+        return leaf(bits);
+    }
+    int64_t half = (int64_t)1 << (level - 1);
+    size_t base = nkept;
+    Node* a = keep(build(b, x0, y0, level - 1));
+    Node* c = keep(build(b, x0 + half, y0, level - 1));
+    Node* d = keep(build(b, x0, y0 + half, level - 1));
+    Node* e = keep(build(b, x0 + half, y0 + half, level - 1));
+    Node* n = node(a, c, d, e);
+    nkept = base;
+    return n;
+}
+
+static void export (Board* b, Node* n, int64_t x0, int64_t y0) {
+    int64_t size = (int64_t)1 << n->level;
+    if (n->pop == 0 || x0 >= b->width || y0 >= b->height || x0 + size <= 0 || y0 + size <= 0)
+        return;
+    if (n->level == LEAF_LEVEL) {
+        int y;
+        for (y = 0; y < 8; y++) {
+            if (y0 + y < b->height) {
+                uint64_t bits = n->bits >> (y * 8) & 0xff;
+                b->cells[(size_t)(y0 + y) * b->words + x0 / 64] |= bits << (x0 % 64);
+            }
+        }
+        return;
+    }
+    int64_t half = size / 2;
+    export(b, n->child[0], x0, y0);
+    export(b, n->child[1], x0 + half, y0);
+    export(b, n->child[2], x0, y0 + half);
+    export(b, n->child[3], x0 + half, y0 + half);
+}
+
+ // Returns n with the cells of its leaf at x, y flagged in mask replaced
+ // by those in bits.
+static Node* set_leaf (Node* n, int64_t x, int64_t y, uint64_t mask, uint64_t bits) {
+    if (n->level == LEAF_LEVEL) return leaf((n->bits & ~mask) | bits);
+    int64_t half = (int64_t)1 << (n->level - 1);
+    int i = (x >= half) + 2 * (y >= half);
+    Node* c [4] = {n->child[0], n->child[1], n->child[2], n->child[3]};
+    size_t base = nkept;
+    c[i] = keep(set_leaf(c[i], x - (i & 1) * half, y - (i >> 1) * half, mask, bits));
+    Node* r = node(c[0], c[1], c[2], c[3]);
+    nkept = base;
+    return r;
+}
+
+ // Puts the leaves of the window that differ from what the universe last
+ // had there into it, leaving everything outside the window alone.
+static void patch_window (Board* b) {
+    int64_t half = (int64_t)1 << (root->level - 1);
+    int y0, j, k, y;
+    for (y0 = 0; y0 < b->height; y0 += 8) {
+        for (j = 0; j < b->words; j++) {
+            uint64_t diff = 0;
+            for (y = y0; y < y0 + 8 && y < b->height; y++) {
+                size_t i = (size_t)y * b->words + j;
+                diff |= b->cells[i] ^ synced_cells[i];
+            }
+            for (k = 0; k < 8; k++) {
+                if (!(diff >> (k * 8) & 0xff)) continue;
+                int x0 = j * 64 + k * 8;
+                uint64_t row_mask = b->width - x0 >= 8 ? 0xff : ((uint64_t)1 << (b->width - x0)) - 1;
+                uint64_t mask = 0, bits = 0;
+                for (y = 0; y < 8 && y0 + y < b->height; y++) {
+                    mask |= row_mask << (y * 8);
+                    bits |= (b->cells[(size_t)(y0 + y) * b->words + j] >> (k * 8) & 0xff) << (y * 8);
+                }
+                root = set_leaf(root, half + x0, half + y0, mask, bits & mask);
+            }
+        }
+    }
+}
+
+static void remember_window (Board* b) {
+    size_t words = (size_t)b->words * b->height;
+    if (synced_board != b || synced_width != b->width || synced_height != b->height) {
+        free(synced_cells);
+        synced_cells = alloc_words(words);
+    }
+    memcpy(synced_cells, b->cells, words * sizeof(uint64_t));
+    synced_board = b;
+    synced_width = b->width;
+    synced_height = b->height;
+    synced_edits = b->edits;
+    synced_generation = b->generation;
+}
+
+ // Brings the universe up to date with the board.  Edits to the board we
+ // left there last time are patched in; any other board, or one moved to
+ // another generation, is loaded afresh.
+static void sync_from_board (Board* b) {
+    if (root && synced_board == b && synced_edits == b->edits
+     && synced_generation == b->generation) return;
+    if (root && synced_board == b && synced_width == b->width && synced_height == b->height
+     && synced_generation == b->generation) {
+        patch_window(b);
+    }
+    else {
+        root = NULL;
+        int level = LEAF_LEVEL;
+        while (((int64_t)1 << level) < b->width || ((int64_t)1 << level) < b->height) level++;
+        Node* e = empty_node(level);
+        Node* n = keep(build(b, 0, 0, level));
+        root = node(e, e, e, n);
+        nkept--;
+    }
+    remember_window(b);
+}
+
+ // Memoized results are only good for the rule they were stepped under.
+static void forget_other_rules () {
+    if (memo_birth == rule.birth_mask && memo_survive == rule.survive_mask) return;
+    size_t i;
+    for (i = 0; i < nbuckets; i++) {
+        Node* n;
+        for (n = buckets[i]; n; n = n->next) n->result = NULL;
+    }
+    memo_birth = rule.birth_mask;
+    memo_survive = rule.survive_mask;
+}
+
+void hashlife_step (Board* b, uint64_t gens) {
+    forget_other_rules();
+    sync_from_board(b);
+    while (gens) {
+         // Stepping 2^step takes a root of level step + 4, which has to fit
+         // under MAX_LEVEL, so bigger jumps go in several steps.
+        int step = 63 - __builtin_clzll(gens);
+        if (step > MAX_LEVEL - 4) step = MAX_LEVEL - 4;
+        while (root->level < step + 3 || root->level < LEAF_LEVEL + 2 || !centered(root)) {
+            if (root->level >= MAX_LEVEL - 1) {
+                fprintf(stderr, "The pattern has outgrown HashLife's universe, 2^%d cells across.\n", MAX_LEVEL);
+                exit(1);
+            }
+            root = expand(root);
+        }
+        root = expand(root);
+        root = step_node(root, step);
+        gens -= (uint64_t)1 << step;
+        b->generation += (uint64_t)1 << step;
+    }
+    memset(b->cells, 0, (size_t)b->words * b->height * sizeof(uint64_t));
+    int64_t half = (int64_t)1 << (root->level - 1);
+    export(b, root, -half, -half);
+    for (int y = 0; y < b->height; y++) {
+        b->cells[(size_t)y * b->words + b->words - 1] &= b->tail;
+    }
+    remember_window(b);
+}
+
+uint64_t hashlife_population (Board* b) {
+    sync_from_board(b);
+    return root->pop;
+}
+
+void hashlife_report (Board* b) {
+    printf("HashLife nodes: %zu (%.1fMB)\n", nnodes, nnodes * (sizeof(Node) + sizeof(Node*)) / 1048576.0);
+}
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // History is a list of the states a board has been in, stored as the XOR
+ // of each state with the one before it, so going either way is applying
+ // the same delta and costs only as much as what changed.  Deltas and
+ // keyframes are stored with runs of zero words squeezed out: a token word
+ // of (literals << 32 | zeros), then the literal words.  A keyframe of the
+ // whole board is kept whenever the deltas since the last one add up to
+ // several times its size, which bounds how much seeking has to apply.
+ //
+ // States are numbered from when recording started; state i + 1 is delta i
+ // applied to state i.  A state is the board's cells and then, under a
+ // Generations rule, its age planes, each encoded in turn.  The oldest
+ // deltas are dropped to stay within
+ // history_depth and history_mem.  Recording diffs the whole board every
+ // generation, so there's none unless -history= asks for it.
+
+long long history_depth = 0;
+long long history_mem = 256;  // In MB
+
+typedef struct Delta {
+    uint64_t generation;  // Of the state after this delta
+    uint64_t offset;  // Bytes of all deltas ever recorded before this one
+    size_t len;
+    size_t ages_at;  // Where the age planes' part of words starts
+    uint64_t* words;
+} Delta;
+
+typedef struct Keyframe {
+    uint64_t state;
+    size_t len;
+    size_t ages_at;
+    uint64_t* words;
+} Keyframe;
+
+Board* history_board;
+int history_planes;  // Age planes of the board when recording started
+uint64_t* last;  // The current state, to diff the next one against
+uint64_t* last_ages;
+uint64_t* scratch;
+Delta* deltas;  // Ring of delta_cap, indexed by state % delta_cap
+uint64_t delta_cap;
+uint64_t first;  // Oldest state kept
+uint64_t end;  // Newest state recorded
+uint64_t cursor;  // State the board is in
+uint64_t first_generation;
+uint64_t end_offset;
+Keyframe* keyframes;  // Oldest first
+int nkeyframes;
+int keyframe_cap;
+size_t history_bytes;
+
+static size_t board_words (const Board* b) {
+    return (size_t)b->words * b->height;
+}
+
+static size_t age_words (const Board* b) {
+    return (size_t)b->age_planes * b->words * b->height;
+}
+
+ // Encodes a ^ b (or just a if b is NULL) into out, which needs room for
+ // n + 2 words, and returns the number of words used.
+static size_t encode_xor (const uint64_t* a, const uint64_t* b, size_t n, uint64_t* out) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        size_t zeros = 0, lits = 0;
+        while (i + zeros < n && !(a[i + zeros] ^ (b ? b[i + zeros] : 0)) && zeros < UINT32_MAX)
+            zeros++;
+        i += zeros;
+        if (i == n) break;
+        size_t token = o++;
+         // Literals run until two unchanged words in a row.
+        while (i < n && lits < UINT32_MAX) {
+            uint64_t w = a[i] ^ (b ? b[i] : 0);
+            if (!w && (i + 1 >= n || !(a[i + 1] ^ (b ? b[i + 1] : 0)))) break;
+            out[o++] = w;
+            lits++;
+            i++;
+        }
+        out[token] = (uint64_t)lits << 32 | zeros;
+    }
+    return o;
+}
+
+ // XORs an encoded delta into p.
+static void apply_xor (const uint64_t* in, size_t len, uint64_t* p) {
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint64_t zeros = in[i] & 0xffffffff;
+        uint64_t lits = in[i] >> 32;
+        i++;
+        o += zeros;
+        uint64_t k;
+        for (k = 0; k < lits; k++) p[o++] ^= in[i++];
+    }
+}
+
+ // Encodes the board's state, XORed with the last one if against_last, into
+ // scratch, and returns the words used, with where the age planes' part
+ // starts in *ages_at.
+static size_t encode_state (const Board* b, int against_last, size_t* ages_at) {
+    size_t len = encode_xor(b->cells, against_last ? last : NULL, board_words(b), scratch);
+    *ages_at = len;
+    if (b->age_planes) {
+        len += encode_xor(b->ages, against_last ? last_ages : NULL, age_words(b), scratch + len);
+    }
+    return len;
+}
+
+static void apply_state (const uint64_t* in, size_t len, size_t ages_at, uint64_t* cells, uint64_t* ages) {
+    apply_xor(in, ages_at, cells);
+    if (ages) apply_xor(in + ages_at, len - ages_at, ages);
+}
+
+static uint64_t* copy_words (const uint64_t* p, size_t n) {
+    uint64_t* r = malloc(n ? n * sizeof(uint64_t) : 1);
+    if (!r) {
+        fprintf(stderr, "Out of memory recording history.\n");
+        exit(1);
+    }
+    memcpy(r, p, n * sizeof(uint64_t));
+    history_bytes += n * sizeof(uint64_t);
+    return r;
+}
+
+static Delta* delta_at (uint64_t state) {
+    return &deltas[state % delta_cap];
+}
+
+static uint64_t offset_of (uint64_t state) {
+    return state == end ? end_offset : delta_at(state)->offset;
+}
+
+static void drop_future () {
+    while (end > cursor) {
+        end--;
+        Delta* d = delta_at(end);
+        history_bytes -= d->len * sizeof(uint64_t);
+        free(d->words);
+        end_offset = d->offset;
+    }
+    while (nkeyframes && keyframes[nkeyframes - 1].state > cursor) {
+        nkeyframes--;
+        history_bytes -= keyframes[nkeyframes].len * sizeof(uint64_t);
+        free(keyframes[nkeyframes].words);
+    }
+}
+
+static void drop_oldest () {
+    Delta* d = delta_at(first);
+    first_generation = d->generation;
+    history_bytes -= d->len * sizeof(uint64_t);
+    free(d->words);
+    first++;
+    int k = 0;
+    while (k < nkeyframes && keyframes[k].state < first) {
+        history_bytes -= keyframes[k].len * sizeof(uint64_t);
+        free(keyframes[k].words);
+        k++;
+    }
+    memmove(keyframes, keyframes + k, (nkeyframes - k) * sizeof(Keyframe));
+    nkeyframes -= k;
+}
+
+static void add_keyframe (Board* b) {
+    if (nkeyframes == keyframe_cap) {
+        keyframe_cap = keyframe_cap ? keyframe_cap * 2 : 16;
+        keyframes = realloc(keyframes, keyframe_cap * sizeof(Keyframe));
+    }
+    size_t ages_at;
+    size_t len = encode_state(b, 0, &ages_at);
+    Keyframe* k = &keyframes[nkeyframes++];
+    k->state = end;
+    k->len = len;
+    k->ages_at = ages_at;
+    k->words = copy_words(scratch, len);
+}
+
+void history_reset (Board* b) {
+    while (end > first) {
+        end--;
+        free(delta_at(end)->words);
+    }
+    while (nkeyframes) free(keyframes[--nkeyframes].words);
+    free(last);
+    free(last_ages);
+    free(scratch);
+    free(deltas);
+    history_board = b;
+    history_planes = b->age_planes;
+    delta_cap = history_depth > 0 ? history_depth : 1;
+    if (delta_cap > 1 << 20) delta_cap = 1 << 20;
+    deltas = calloc(delta_cap, sizeof(Delta));
+    last = alloc_words(board_words(b));
+    last_ages = b->age_planes ? alloc_words(age_words(b)) : NULL;
+    scratch = alloc_words(board_words(b) + age_words(b) + 4);
+    memcpy(last, b->cells, board_words(b) * sizeof(uint64_t));
+    if (last_ages) memcpy(last_ages, b->ages, age_words(b) * sizeof(uint64_t));
+    first = end = cursor = 0;
+    first_generation = b->generation;
+    end_offset = 0;
+    history_bytes = 0;
+    add_keyframe(b);
+}
+
+ // Records the board's current state as following the state it was last
+ // in, dropping any states that had been stepped back past.
+void history_record (Board* b) {
+    if (history_depth <= 0) return;
+    if (b != history_board || b->age_planes != history_planes) {
+        history_reset(b);
+        return;
+    }
+    size_t n = board_words(b);
+    drop_future();
+    if (end - first == delta_cap) {
+         // Grow the ring while under the depth asked for.
+        if (delta_cap < (uint64_t)history_depth) {
+            uint64_t cap = delta_cap * 2 < (uint64_t)history_depth ? delta_cap * 2 : history_depth;
+            Delta* nd = calloc(cap, sizeof(Delta));
+            uint64_t s;
+            for (s = first; s < end; s++) nd[s % cap] = *delta_at(s);
+            free(deltas);
+            deltas = nd;
+            delta_cap = cap;
+        }
+        else drop_oldest();
+    }
+    size_t ages_at;
+    size_t len = encode_state(b, 1, &ages_at);
+    Delta* d = delta_at(end);
+    d->generation = b->generation;
+    d->offset = end_offset;
+    d->len = len;
+    d->ages_at = ages_at;
+    d->words = copy_words(scratch, len);
+    end_offset += len * sizeof(uint64_t);
+    end++;
+    cursor = end;
+    memcpy(last, b->cells, n * sizeof(uint64_t));
+    if (last_ages) memcpy(last_ages, b->ages, age_words(b) * sizeof(uint64_t));
+    if (!nkeyframes || end_offset - offset_of(keyframes[nkeyframes - 1].state)
+                       > 4 * keyframes[nkeyframes - 1].len * sizeof(uint64_t))
+        add_keyframe(b);
+    while (end - first > 1 && history_bytes > history_mem * 1024 * 1024) drop_oldest();
+}
+
+static uint64_t generation_of (uint64_t state) {
+    return state == first ? first_generation : delta_at(state - 1)->generation;
+}
+
+static void set_state (Board* b, uint64_t state) {
+    while (cursor > state) {
+        Delta* d = delta_at(--cursor);
+        apply_state(d->words, d->len, d->ages_at, b->cells, b->ages);
+        apply_state(d->words, d->len, d->ages_at, last, last_ages);
+    }
+    while (cursor < state) {
+        Delta* d = delta_at(cursor++);
+        apply_state(d->words, d->len, d->ages_at, b->cells, b->ages);
+        apply_state(d->words, d->len, d->ages_at, last, last_ages);
+    }
+    b->generation = generation_of(cursor);
+    b->edits++;
+}
+
+ // Steps the board back one recorded state.  Returns 0 if there's no
+ // earlier state kept.
+int history_back (Board* b) {
+    if (b != history_board || b->age_planes != history_planes || cursor <= first) return 0;
+    set_state(b, cursor - 1);
+    return 1;
+}
+
+ // Replays the next recorded state after having stepped back.  Returns 0 if
+ // the board is at the newest state.
+int history_forward (Board* b) {
+    if (b != history_board || b->age_planes != history_planes || cursor >= end) return 0;
+    set_state(b, cursor + 1);
+    return 1;
+}
+
+ // Moves the board to the last recorded state of generation (or the nearest
+ // one kept, if it's out of range), starting from a keyframe if that means
+ // applying fewer deltas.
+void history_seek (Board* b, uint64_t generation) {
+    if (b != history_board || b->age_planes != history_planes) return;
+    uint64_t lo = first, hi = end;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if (generation_of(mid) <= generation) lo = mid;
+        else hi = mid - 1;
+    }
+    uint64_t target = lo;
+    uint64_t to = offset_of(target);
+    uint64_t from = offset_of(cursor);
+    uint64_t best = from > to ? from - to : to - from;
+    int k, best_key = -1;
+    for (k = 0; k < nkeyframes; k++) {
+        uint64_t at = offset_of(keyframes[k].state);
+        uint64_t cost = keyframes[k].len * sizeof(uint64_t) + (at > to ? at - to : to - at);
+        if (cost < best) {
+            best = cost;
+            best_key = k;
+        }
+    }
+    if (best_key >= 0) {
+        Keyframe* key = &keyframes[best_key];
+        size_t n = board_words(b);
+        memset(b->cells, 0, n * sizeof(uint64_t));
+        if (b->ages) memset(b->ages, 0, age_words(b) * sizeof(uint64_t));
+        apply_state(key->words, key->len, key->ages_at, b->cells, b->ages);
+        memcpy(last, b->cells, n * sizeof(uint64_t));
+        if (last_ages) memcpy(last_ages, b->ages, age_words(b) * sizeof(uint64_t));
+        cursor = key->state;
+    }
+    set_state(b, target);
+}
+
+ // The range of generations that can be sought to.
+void history_range (uint64_t* oldest, uint64_t* newest) {
+    *oldest = generation_of(first);
+    *newest = generation_of(end);
+}
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // An unbounded universe of 64x64 chunks, one word per row, kept in a hash
+ // map by chunk coordinates.  Only chunks with live cells exist, plus empty
+ // ones next to live cells on their edges, which are made just before a
+ // step that could spread into them; chunks that step to empty are freed.
+ // So memory follows the population rather than its bounding box, and
+ // gliders fly off forever instead of dying at an edge or wrapping around.
+ // Like HashLife, the board is a window onto the universe with its
+ // lower-left corner at the origin, so chunk (cx, cy) is board word cx of
+ // rows 64*cy to 64*cy + 63 where it overlaps.
+ //
+ // Chunks come from blocks of INFINITE_BLOCK_CHUNKS, and a block is given
+ // back once none of its chunks are in use.
+
+#define CHUNK_SIZE 64
+#define INFINITE_BLOCK_CHUNKS 256
+
+typedef struct Chunk {
+    uint64_t cells [CHUNK_SIZE];  // Row r is y = 64*cy + r
+    uint64_t next [CHUNK_SIZE];
+    int32_t cx;
+    int32_t cy;
+    struct Chunk* around [8];  // Neighbors for this step, NULL if empty
+    struct Chunk* free_next;
+    struct Block* block;
+    int in_use;
+    int empty;  // Stepped to nothing, to be freed
+} Chunk;
+
+typedef struct Block {
+    struct Block* next;
+    int used;
+    Chunk chunks [INFINITE_BLOCK_CHUNKS];
+} Block;
+
+Block* blocks;
+size_t nblocks;
+Chunk* free_chunks;
+size_t nfree;
+
+Chunk** table;  // Open addressing with linear probing
+size_t table_cap;
+Chunk** live;  // Every chunk in the table
+size_t nlive;
+size_t live_cap;
+
+Board* infinite_board;
+uint64_t infinite_edits = -1;
+uint64_t infinite_generation;
+int infinite_width, infinite_height;
+
+ // Offsets of the eight neighbors, in the order of Chunk.around.
+static const int around_dx [8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int around_dy [8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+static size_t chunk_hash (int32_t cx, int32_t cy) {
+    uint64_t h = (uint64_t)(uint32_t)cx << 32 | (uint32_t)cy;
+    h = (h ^ h >> 30) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ h >> 27) * 0x94D049BB133111EBull;
+    return h ^ h >> 31;
+}
+
+static Chunk* find_chunk (int32_t cx, int32_t cy) {
+    if (!table) return NULL;
+    size_t i = chunk_hash(cx, cy) & (table_cap - 1);
+    while (table[i]) {
+        if (table[i]->cx == cx && table[i]->cy == cy) return table[i];
+        i = (i + 1) & (table_cap - 1);
+    }
+    return NULL;
+}
+
+static void insert_chunk (Chunk* c) {
+    size_t i = chunk_hash(c->cx, c->cy) & (table_cap - 1);
+    while (table[i]) i = (i + 1) & (table_cap - 1);
+    table[i] = c;
+}
+
+static void grow_table () {
+    Chunk** old = table;
+    size_t old_cap = table_cap;
+    table_cap = table_cap ? table_cap * 2 : 1024;
+    table = calloc(table_cap, sizeof(Chunk*));
+    if (!table) {
+        fprintf(stderr, "Out of memory for the chunk table.\n");
+        exit(1);
+    }
+    size_t i;
+    for (i = 0; i < old_cap; i++) {
+        if (old[i]) insert_chunk(old[i]);
+    }
+    free(old);
+}
+
+ // Takes c out of the table, moving later entries of its probe run back so
+ // that lookups never stop early at the hole.
+static void remove_chunk (Chunk* c) {
+    size_t mask = table_cap - 1;
+    size_t i = chunk_hash(c->cx, c->cy) & mask;
+    while (table[i] != c) i = (i + 1) & mask;
+    size_t j = i;
+    for (;;) {
+        table[i] = NULL;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (!table[j]) return;
+            size_t home = chunk_hash(table[j]->cx, table[j]->cy) & mask;
+             // Move it back unless its home is cyclically in (i, j].
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+            break;
+        }
+        table[i] = table[j];
+        i = j;
+    }
+}
+
+static Chunk* alloc_chunk () {
+    if (!free_chunks) {
+        Block* k = malloc(sizeof(Block));
+        if (!k) {
+            fprintf(stderr, "Out of memory allocating chunks.\n");
+            exit(1);
+        }
+        k->next = blocks;
+        k->used = 0;
+        blocks = k;
+        nblocks++;
+        int i;
+        for (i = INFINITE_BLOCK_CHUNKS - 1; i >= 0; i--) {
+            k->chunks[i].block = k;
+            k->chunks[i].in_use = 0;
+            k->chunks[i].free_next = free_chunks;
+            free_chunks = &k->chunks[i];
+        }
+        nfree += INFINITE_BLOCK_CHUNKS;
+    }
+    Chunk* c = free_chunks;
+    free_chunks = c->free_next;
+    nfree--;
+    c->in_use = 1;
+    c->block->used++;
+    return c;
+}
+
+static void free_chunk (Chunk* c) {
+    c->in_use = 0;
+    c->block->used--;
+    c->free_next = free_chunks;
+    free_chunks = c;
+    nfree++;
+}
+
+ // Gives back blocks with nothing in use, once there are more free chunks
+ // than live ones, and rebuilds the free list from what's left.
+static void release_blocks () {
+    if (nfree <= nlive + INFINITE_BLOCK_CHUNKS) return;
+    Block** p = &blocks;
+    free_chunks = NULL;
+    nfree = 0;
+    while (*p) {
+        Block* k = *p;
+        if (!k->used) {
+            *p = k->next;
+            free(k);
+            nblocks--;
+            continue;
+        }
+        int i;
+        for (i = 0; i < INFINITE_BLOCK_CHUNKS; i++) {
+            if (!k->chunks[i].in_use) {
+                k->chunks[i].free_next = free_chunks;
+                free_chunks = &k->chunks[i];
+                nfree++;
+            }
+        }
+        p = &k->next;
+    }
+}
+
+static Chunk* get_chunk (int32_t cx, int32_t cy) {
+    Chunk* c = find_chunk(cx, cy);
+    if (c) return c;
+    if ((nlive + 1) * 2 > table_cap) grow_table();
+    c = alloc_chunk();
+    memset(c->cells, 0, sizeof c->cells);
+    c->cx = cx;
+    c->cy = cy;
+    insert_chunk(c);
+    if (nlive == live_cap) {
+        live_cap = live_cap ? live_cap * 2 : 1024;
+        live = realloc(live, live_cap * sizeof(Chunk*));
+    }
+    live[nlive++] = c;
+    return c;
+}
+
+static void clear_universe () {
+    size_t i;
+    for (i = 0; i < nlive; i++) free_chunk(live[i]);
+    nlive = 0;
+    if (table) memset(table, 0, table_cap * sizeof(Chunk*));
+}
+
+ // Makes the empty chunks that live cells on an edge could spread into.
+static void make_borders () {
+    size_t i, n = nlive;
+    for (i = 0; i < n; i++) {
+        Chunk* c = live[i];
+        uint64_t any = 0;
+        int r;
+        for (r = 0; r < CHUNK_SIZE; r++) any |= c->cells[r];
+        if (!any) continue;
+        uint64_t south = c->cells[0], north = c->cells[CHUNK_SIZE - 1];
+        if (south) get_chunk(c->cx, c->cy - 1);
+        if (north) get_chunk(c->cx, c->cy + 1);
+        if (any & 1) get_chunk(c->cx - 1, c->cy);
+        if (any >> 63) get_chunk(c->cx + 1, c->cy);
+        if (south & 1) get_chunk(c->cx - 1, c->cy - 1);
+        if (south >> 63) get_chunk(c->cx + 1, c->cy - 1);
+        if (north & 1) get_chunk(c->cx - 1, c->cy + 1);
+        if (north >> 63) get_chunk(c->cx + 1, c->cy + 1);
+    }
+}
+
+ // Gathers column dx of c's neighborhood (dx of -1 for the chunk to the
+ // west, 1 for the east) into col, with the row below the chunk first and
+ // the row above it last.
+static void gather_column (const Chunk* c, int dx, uint64_t* col) {
+    const Chunk* below = c->around[1 + dx];
+    const Chunk* mid = dx ? c->around[dx < 0 ? 3 : 4] : c;
+    const Chunk* above = c->around[6 + dx];
+    col[0] = below ? below->cells[CHUNK_SIZE - 1] : 0;
+    if (mid) memcpy(col + 1, mid->cells, sizeof mid->cells);
+    else memset(col + 1, 0, sizeof mid->cells);
+    col[CHUNK_SIZE + 1] = above ? above->cells[0] : 0;
+}
+
+ // Computes c's next generation, returning whether anything's alive in it.
+static int step_chunk (Chunk* c) {
+    uint64_t w [CHUNK_SIZE + 2], m [CHUNK_SIZE + 2], e [CHUNK_SIZE + 2];
+    uint64_t any = 0;
+    int r;
+    gather_column(c, -1, w);
+    gather_column(c, 0, m);
+    gather_column(c, 1, e);
+    for (r = 1; r <= CHUNK_SIZE; r++) {
+        uint64_t u = m[r + 1], mj = m[r], d = m[r - 1];
+        uint64_t out = rule.kernel == RULE_LIFE
+            ? LIFE_WORD(
+                u << 1 | w[r + 1] >> 63, u, u >> 1 | e[r + 1] << 63,
+                mj << 1 | w[r] >> 63, mj, mj >> 1 | e[r] << 63,
+                d << 1 | w[r - 1] >> 63, d, d >> 1 | e[r - 1] << 63
+            )
+            : RULE_WORD(
+                u << 1 | w[r + 1] >> 63, u, u >> 1 | e[r + 1] << 63,
+                mj << 1 | w[r] >> 63, mj, mj >> 1 | e[r] << 63,
+                d << 1 | w[r - 1] >> 63, d, d >> 1 | e[r - 1] << 63,
+                rule.birth_mask, rule.survive_mask
+            );
+        c->next[r - 1] = out;
+        any |= out;
+    }
+    return any != 0;
+}
+
+static void step_universe () {
+    size_t i, kept = 0;
+    int k;
+    make_borders();
+    for (i = 0; i < nlive; i++) {
+        Chunk* c = live[i];
+        for (k = 0; k < 8; k++) c->around[k] = find_chunk(c->cx + around_dx[k], c->cy + around_dy[k]);
+    }
+     // Every chunk's next generation has to be worked out before any of
+     // them change, so the swap and freeing come after.
+    for (i = 0; i < nlive; i++) live[i]->empty = !step_chunk(live[i]);
+    for (i = 0; i < nlive; i++) {
+        Chunk* c = live[i];
+        if (c->empty) {
+            remove_chunk(c);
+            free_chunk(c);
+            continue;
+        }
+        memcpy(c->cells, c->next, sizeof c->cells);
+        live[kept++] = c;
+    }
+    nlive = kept;
+}
+
+ // Brings the universe up to date with the board.  Edits to the board we
+ // left there last time are written over the window, leaving the chunks
+ // outside it (and the cells past the board's right edge in its last
+ // column) alone; any other board, or one moved to another generation, is
+ // loaded afresh.  Chunks the edits emptied are freed by the next step.
+static void sync_from_board (Board* b) {
+    if (infinite_board == b && infinite_edits == b->edits
+     && infinite_generation == b->generation) return;
+    if (infinite_board != b || infinite_width != b->width || infinite_height != b->height
+     || infinite_generation != b->generation) clear_universe();
+    int y0, y, j;
+    for (y0 = 0; y0 < b->height; y0 += CHUNK_SIZE) {
+        for (j = 0; j < b->words; j++) {
+            uint64_t mask = j == b->words - 1 ? b->tail : ~(uint64_t)0;
+            Chunk* c = find_chunk(j, y0 / CHUNK_SIZE);
+            for (y = y0; y < y0 + CHUNK_SIZE && y < b->height; y++) {
+                uint64_t w = b->cells[(size_t)y * b->words + j];
+                if (w && !c) c = get_chunk(j, y0 / CHUNK_SIZE);
+                if (c) c->cells[y - y0] = (c->cells[y - y0] & ~mask) | w;
+            }
+        }
+    }
+    infinite_board = b;
+    infinite_width = b->width;
+    infinite_height = b->height;
+}
+
+static void export (Board* b) {
+    size_t i;
+    memset(b->cells, 0, (size_t)b->words * b->height * sizeof(uint64_t));
+    for (i = 0; i < nlive; i++) {
+        Chunk* c = live[i];
+        if (c->cx < 0 || c->cx >= b->words || c->cy < 0) continue;
+        int64_t y0 = (int64_t)c->cy * CHUNK_SIZE;
+        int r;
+        for (r = 0; r < CHUNK_SIZE && y0 + r < b->height; r++) {
+            b->cells[(size_t)(y0 + r) * b->words + c->cx] = c->cells[r];
+        }
+    }
+    for (i = 0; i < (size_t)b->height; i++) {
+        b->cells[i * b->words + b->words - 1] &= b->tail;
+    }
+}
+
+void infinite_step (Board* b, uint64_t gens) {
+    sync_from_board(b);
+    while (gens--) {
+        step_universe();
+        b->generation++;
+    }
+    release_blocks();
+    export(b);
+    infinite_edits = b->edits;
+    infinite_generation = b->generation;
+}
+
+uint64_t infinite_population (Board* b) {
+    sync_from_board(b);
+    infinite_edits = b->edits;
+    infinite_generation = b->generation;
+    uint64_t pop = 0;
+    size_t i;
+    int r;
+    for (i = 0; i < nlive; i++) {
+        for (r = 0; r < CHUNK_SIZE; r++) pop += __builtin_popcountll(live[i]->cells[r]);
+    }
+    return pop;
+}
+
+void infinite_report (Board* b) {
+    int64_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    size_t i;
+    for (i = 0; i < nlive; i++) {
+        Chunk* c = live[i];
+        if (!i || c->cx < x0) x0 = c->cx;
+        if (!i || c->cy < y0) y0 = c->cy;
+        if (!i || c->cx > x1) x1 = c->cx;
+        if (!i || c->cy > y1) y1 = c->cy;
+    }
+    printf("Chunks: %zu live of %zu pooled (%.1fMB), spanning %lldx%lld cells\n",
+        nlive, nblocks * INFINITE_BLOCK_CHUNKS, nblocks * sizeof(Block) / 1048576.0,
+        nlive ? (long long)(x1 - x0 + 1) * CHUNK_SIZE : 0,
+        nlive ? (long long)(y1 - y0 + 1) * CHUNK_SIZE : 0
+    );
+}
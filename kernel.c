@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // The word logic for each RULE_ kernel.  The generic one reads the rule's
+ // masks from locals every span sets up.
+#define LIFE(...) LIFE_WORD(__VA_ARGS__)
+#define HIGHLIFE(...) RULE_WORD(__VA_ARGS__, 0x048, 0x00c)
+#define DAY_NIGHT(...) RULE_WORD(__VA_ARGS__, 0x1c8, 0x1d8)
+#define SEEDS(...) RULE_WORD(__VA_ARGS__, 0x004, 0x000)
+#define GENERIC(...) RULE_WORD(__VA_ARGS__, birth, survive)
+
+ // Steps one word whose neighbors in the row are all real words.
+#define INTERIOR(WORD, up, mid, down, j) ({ \
+    uint64_t uj = up[j], mj = mid[j], dj = down[j]; \
+    WORD( \
+        uj << 1 | up[j-1] >> 63, uj, uj >> 1 | up[j+1] << 63, \
+        mj << 1 | mid[j-1] >> 63, mj, mj >> 1 | mid[j+1] << 63, \
+        dj << 1 | down[j-1] >> 63, dj, dj >> 1 | down[j+1] << 63 \
+    ); \
+})
+
+#define RULE_LOCALS \
+    __attribute__((unused)) uint64_t birth = rule.birth_mask; \
+    __attribute__((unused)) uint64_t survive = rule.survive_mask;
+
+ // Spans cover words j0 to j1, which must not include the first or last
+ // word of a row.
+#define SCALAR_SPAN(name, WORD) \
+void name ( \
+    const uint64_t* up, const uint64_t* mid, const uint64_t* down, \
+    uint64_t* out, int j0, int j1 \
+) { \
+    RULE_LOCALS \
+    int j; \
+    for (j = j0; j < j1; j++) { \
+        out[j] = INTERIOR(WORD, up, mid, down, j); \
+    } \
+}
+
+ // The vector kernels load each row three times, offset by a word either
+ // way, so that the bits crossing word boundaries line up without shuffles.
+#define VECTOR_SPAN(name, target_name, N, WORD) \
+typedef uint64_t name##_vec __attribute__((vector_size(N * 8))); \
+__attribute__((target(target_name))) \
+void name ( \
+    const uint64_t* up, const uint64_t* mid, const uint64_t* down, \
+    uint64_t* out, int j0, int j1 \
+) { \
+    RULE_LOCALS \
+    int j; \
+    for (j = j0; j + N <= j1; j += N) { \
+        name##_vec uv, ul, ur, mv, ml, mr, dv, dl, dr; \
+        memcpy(&uv, up + j, sizeof uv); \
+        memcpy(&ul, up + j - 1, sizeof uv); \
+        memcpy(&ur, up + j + 1, sizeof uv); \
+        memcpy(&mv, mid + j, sizeof uv); \
+        memcpy(&ml, mid + j - 1, sizeof uv); \
+        memcpy(&mr, mid + j + 1, sizeof uv); \
+        memcpy(&dv, down + j, sizeof uv); \
+        memcpy(&dl, down + j - 1, sizeof uv); \
+        memcpy(&dr, down + j + 1, sizeof uv); \
+        name##_vec r = WORD( \
+            uv << 1 | ul >> 63, uv, uv >> 1 | ur << 63, \
+            mv << 1 | ml >> 63, mv, mv >> 1 | mr << 63, \
+            dv << 1 | dl >> 63, dv, dv >> 1 | dr << 63 \
+        ); \
+        memcpy(out + j, &r, sizeof r); \
+    } \
+    for (; j < j1; j++) { \
+        out[j] = INTERIOR(WORD, up, mid, down, j); \
+    } \
+}
+
+SCALAR_SPAN(span_scalar_life, LIFE)
+SCALAR_SPAN(span_scalar_highlife, HIGHLIFE)
+SCALAR_SPAN(span_scalar_day_night, DAY_NIGHT)
+SCALAR_SPAN(span_scalar_seeds, SEEDS)
+SCALAR_SPAN(span_scalar_generic, GENERIC)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_SPANS(prefix, target_name, N) \
+    VECTOR_SPAN(prefix##_life, target_name, N, LIFE) \
+    VECTOR_SPAN(prefix##_highlife, target_name, N, HIGHLIFE) \
+    VECTOR_SPAN(prefix##_day_night, target_name, N, DAY_NIGHT) \
+    VECTOR_SPAN(prefix##_seeds, target_name, N, SEEDS) \
+    VECTOR_SPAN(prefix##_generic, target_name, N, GENERIC)
+VECTOR_SPANS(span_avx2, "avx2", 4)
+VECTOR_SPANS(span_avx512, "avx512f", 8)
+#endif
+
+ // In RULE_ order
+#define SPANS(prefix) { \
+    prefix##_life, prefix##_highlife, prefix##_day_night, prefix##_seeds, prefix##_generic \
+}
+
+Kernel kernels [] = {
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx512", SPANS(span_avx512)},
+    {"avx2", SPANS(span_avx2)},
+#endif
+    {"scalar", SPANS(span_scalar)},
+    {NULL, {NULL}}
+};
+
+int kernel_supported (const Kernel* k) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (0==strcmp(k->name, "avx512")) return __builtin_cpu_supports("avx512f");
+    if (0==strcmp(k->name, "avx2")) return __builtin_cpu_supports("avx2");
+#endif
+    return 1;
+}
+
+const Kernel* kernel = &kernels[sizeof(kernels) / sizeof(Kernel) - 2];
+
+ // Picks the named kernel, or the fastest one this CPU supports if name is
+ // NULL or "auto".
+void select_kernel (const char* name) {
+    Kernel* k;
+    for (k = kernels; k->name; k++) {
+        if (!name || 0==strcmp(name, "auto")) {
+            if (kernel_supported(k)) break;
+        }
+        else if (0==strcmp(name, k->name)) {
+            if (!kernel_supported(k)) {
+                fprintf(stderr, "This CPU does not support the %s kernel.\n", name);
+                exit(1);
+            }
+            break;
+        }
+    }
+    if (!k->name) {
+        fprintf(stderr, "Unknown kernel: %s\n", name);
+        exit(1);
+    }
+    kernel = k;
+}
+
+ // The neighbor bits that get shifted in past the ends of a row.
+static inline uint64_t west_in (const Board* b, const uint64_t* row) {
+    return b->wrap ? row[b->words - 1] >> ((b->width - 1) % 64) & 1 : 0;
+}
+static inline uint64_t east_in (const Board* b, const uint64_t* row) {
+    return b->wrap ? (row[0] & 1) << ((b->width - 1) % 64) : 0;
+}
+
+ // Steps an edge word of a row, where the neighbors past the end come from
+ // the other side of the board or are dead.
+static uint64_t step_edge (
+    const Board* b, const uint64_t* up, const uint64_t* mid,
+    const uint64_t* down, int j
+) {
+    int last = b->words - 1;
+    uint64_t uj = up[j], mj = mid[j], dj = down[j];
+    uint64_t uwi = j ? up[j-1] >> 63 : west_in(b, up);
+    uint64_t mwi = j ? mid[j-1] >> 63 : west_in(b, mid);
+    uint64_t dwi = j ? down[j-1] >> 63 : west_in(b, down);
+    uint64_t uei = j < last ? up[j+1] << 63 : east_in(b, up);
+    uint64_t mei = j < last ? mid[j+1] << 63 : east_in(b, mid);
+    uint64_t dei = j < last ? down[j+1] << 63 : east_in(b, down);
+    uint64_t r = rule.kernel == RULE_LIFE
+        ? LIFE_WORD(
+            uj << 1 | uwi, uj, uj >> 1 | uei,
+            mj << 1 | mwi, mj, mj >> 1 | mei,
+            dj << 1 | dwi, dj, dj >> 1 | dei
+        )
+        : RULE_WORD(
+            uj << 1 | uwi, uj, uj >> 1 | uei,
+            mj << 1 | mwi, mj, mj >> 1 | mei,
+            dj << 1 | dwi, dj, dj >> 1 | dei,
+            rule.birth_mask, rule.survive_mask
+        );
+    return j == last ? r & b->tail : r;
+}
+
+ // Computes words j0 to j1 of a row of the next generation.
+void step_row (
+    const Board* b, const uint64_t* up, const uint64_t* mid,
+    const uint64_t* down, uint64_t* out, int j0, int j1
+) {
+    int last = b->words - 1;
+    if (j0 == 0) {
+        out[0] = step_edge(b, up, mid, down, 0);
+        j0 = 1;
+    }
+    if (j1 > last && last >= j0) {
+        out[last] = step_edge(b, up, mid, down, last);
+        j1 = last;
+    }
+    if (j0 < j1) kernel->spans[rule.kernel](up, mid, down, out, j0, j1);
+}
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "golsh.h"
+
+uint64_t* alloc_words (size_t n) {
+    size_t bytes = (n * sizeof(uint64_t) + 63) & ~(size_t)63;
+    uint64_t* p = aligned_alloc(64, bytes ? bytes : 64);
+    if (!p) {
+        fprintf(stderr, "Out of memory allocating %zu bytes.\n", bytes);
+        exit(1);
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+Board* board_new (int width, int height, int wrap) {
+    if (width < 1 || height < 1) {
+        fprintf(stderr, "Invalid board size %dx%d.\n", width, height);
+        exit(1);
+    }
+    Board* b = calloc(1, sizeof(Board));
+    b->width = width;
+    b->height = height;
+    b->wrap = wrap;
+    b->words = (width + 63) / 64;
+    b->tail = width % 64 ? ((uint64_t)1 << width % 64) - 1 : ~(uint64_t)0;
+    b->cells = alloc_words((size_t)b->words * height);
+    b->next = alloc_words((size_t)b->words * height);
+    b->zero = alloc_words(b->words);
+    stats_clear(&b->stats);
+    stats_clear(&b->stats_next);
+    return b;
+}
+
+void board_free (Board* b) {
+    free(b->cells);
+    free(b->next);
+    free(b->zero);
+    free(b->ages);
+    free(b);
+}
+
+int board_get (const Board* b, int x, int y) {
+    if (x < 0 || x >= b->width || y < 0 || y >= b->height) return 0;
+    return b->cells[(size_t)y * b->words + x / 64] >> (x % 64) & 1;
+}
+
+static uint64_t* age_plane (const Board* b, int p, int y) {
+    return &b->ages[((size_t)p * b->height + y) * b->words];
+}
+
+ // Setting cells directly makes them plainly alive or dead.
+static void clear_ages (Board* b, int y, int j, uint64_t mask) {
+    int p;
+    for (p = 0; p < b->age_planes; p++) age_plane(b, p, y)[j] &= ~mask;
+}
+
+void board_set (Board* b, int x, int y, int val) {
+    if (x < 0 || x >= b->width || y < 0 || y >= b->height) return;
+    b->edits++;
+    uint64_t* w = &b->cells[(size_t)y * b->words + x / 64];
+    uint64_t bit = (uint64_t)1 << (x % 64);
+    if (val) *w |= bit;
+    else *w &= ~bit;
+    clear_ages(b, y, x / 64, bit);
+}
+
+ // Sets or clears a horizontal run of cells, clipped to the board.
+void board_fill (Board* b, int x, int y, int len, int val) {
+    if (y < 0 || y >= b->height) return;
+    if (x < 0) {
+        len += x;
+        x = 0;
+    }
+    if (len > b->width - x) len = b->width - x;
+    if (len <= 0) return;
+    b->edits++;
+    uint64_t* row = &b->cells[(size_t)y * b->words];
+    while (len > 0) {
+        int bit = x % 64;
+        int n = 64 - bit < len ? 64 - bit : len;
+        uint64_t mask = (n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1) << bit;
+        if (val) row[x / 64] |= mask;
+        else row[x / 64] &= ~mask;
+        clear_ages(b, y, x / 64, mask);
+        x += n;
+        len -= n;
+    }
+}
+
+ // Zeroes n words.  Big buffers have their pages dropped instead of being
+ // written, so the kernel hands back zero pages when they're next touched;
+ // clearing costs next to nothing until the board is used again.
+static void zero_words (uint64_t* p, size_t n) {
+    size_t bytes = n * sizeof(uint64_t);
+#ifdef MADV_DONTNEED
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (bytes >= 256 * page) {
+        char* start = (char*)p;
+        char* end = start + bytes;
+        char* first = (char*)(((uintptr_t)start + page - 1) & ~(uintptr_t)(page - 1));
+        char* last = (char*)((uintptr_t)end & ~(uintptr_t)(page - 1));
+        memset(start, 0, first - start);
+        memset(last, 0, end - last);
+        if (!madvise(first, last - first, MADV_DONTNEED)) return;
+    }
+#endif
+    memset(p, 0, bytes);
+}
+
+void board_clear (Board* b) {
+    b->edits++;
+    zero_words(b->cells, (size_t)b->words * b->height);
+    if (b->ages) zero_words(b->ages, (size_t)b->age_planes * b->words * b->height);
+}
+
+ // Makes room for the ages of dying cells under a Generations rule, which
+ // count down from states - 2 to 0.
+void board_ensure_ages (Board* b) {
+    int planes = 0;
+    while ((1 << planes) < rule.states - 1) planes++;
+    if (planes == b->age_planes) return;
+    free(b->ages);
+    b->age_planes = planes;
+    b->ages = planes ? alloc_words((size_t)planes * b->words * b->height) : NULL;
+}
+
+ // A dying cell in state s of a Generations rule has states - s steps left.
+void board_set_age (Board* b, int x, int y, int age) {
+    if (x < 0 || x >= b->width || y < 0 || y >= b->height) return;
+    board_ensure_ages(b);
+    b->edits++;
+    uint64_t bit = (uint64_t)1 << (x % 64);
+    b->cells[(size_t)y * b->words + x / 64] &= ~bit;
+    int p;
+    for (p = 0; p < b->age_planes; p++) {
+        uint64_t* w = &age_plane(b, p, y)[x / 64];
+        if (age >> p & 1) *w |= bit;
+        else *w &= ~bit;
+    }
+}
+
+int board_get_age (const Board* b, int x, int y) {
+    if (x < 0 || x >= b->width || y < 0 || y >= b->height) return 0;
+    int p, age = 0;
+    for (p = 0; p < b->age_planes; p++) {
+        age |= (age_plane(b, p, y)[x / 64] >> (x % 64) & 1) << p;
+    }
+    return age;
+}
+
+float density = 0.5;
+
+static uint64_t splitmix (uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ z >> 30) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ z >> 27) * 0x94D049BB133111EBull;
+    return z ^ z >> 31;
+}
+
+ // Four xoshiro256** generators side by side, one per lane, so a vector
+ // step makes four words.  The multiplies by 5 and 9 are done as shifts
+ // and adds, which every vector unit has for 64-bit lanes.
+typedef uint64_t rng_vec __attribute__((vector_size(32)));
+#define RNG_LANES 4
+#define ROTL(x, k) ((x) << (k) | (x) >> (64 - (k)))
+
+static inline void xoshiro (rng_vec* s, rng_vec* out) {
+    rng_vec x = s[1] + (s[1] << 2);
+    rng_vec r = ROTL(x, 7);
+    r = r + (r << 3);
+    rng_vec t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL(s[3], 45);
+    *out = r;
+}
+
+ // Cells are alive with probability k / 65536: starting from the lowest set
+ // bit of k, each bit going up either ORs (for a 1) or ANDs (for a 0) in
+ // a fresh random word, halving the distance to 1 or to 0.
+static inline void bernoulli (rng_vec* s, uint32_t k, rng_vec* out) {
+    rng_vec w, r;
+    if (k >= 65536 || !k) {
+        *out = (rng_vec){0} - (k ? 1 : 0);
+        return;
+    }
+    int bit = __builtin_ctz(k);
+    xoshiro(s, &w);
+    for (bit++; bit < 16; bit++) {
+        xoshiro(s, &r);
+        if (k >> bit & 1) w |= r;
+        else w &= r;
+    }
+    *out = w;
+}
+
+ // Every row gets generators of its own, keyed by the seed and the row, so
+ // the soup is the same however the rows are split across threads.
+static void randomize_rows (Board* b, int y0, int y1, void* arg) {
+    uint64_t key = *(uint64_t*)arg;
+    uint32_t k = density <= 0 ? 0 : density >= 1 ? 65536 : (uint32_t)(density * 65536 + 0.5);
+    int y, j, i;
+    for (y = y0; y < y1; y++) {
+        uint64_t sm = key ^ (uint64_t)y * 0xD1B54A32D192ED03ull;
+        rng_vec s [4];
+        for (i = 0; i < 4; i++) {
+            for (j = 0; j < RNG_LANES; j++) s[i][j] = splitmix(&sm);
+        }
+        uint64_t* row = &b->cells[(size_t)y * b->words];
+        rng_vec w;
+        for (j = 0; j + RNG_LANES <= b->words; j += RNG_LANES) {
+            bernoulli(s, k, &w);
+            memcpy(row + j, &w, sizeof w);
+        }
+        if (j < b->words) {
+            bernoulli(s, k, &w);
+            memcpy(row + j, &w, (b->words - j) * sizeof(uint64_t));
+        }
+        row[b->words - 1] &= b->tail;
+    }
+}
+
+ // Fills the board with a soup of the given density, from the seed option.
+void board_randomize (Board* b) {
+    b->edits++;
+    if (b->ages) zero_words(b->ages, (size_t)b->age_planes * b->words * b->height);
+    uint64_t state = (uint32_t)seed;
+    uint64_t key = splitmix(&state);
+    threaded_rows(b, randomize_rows, &key);
+}
+
+uint64_t board_population (const Board* b) {
+    size_t i, n = (size_t)b->words * b->height;
+    uint64_t pop = 0;
+    for (i = 0; i < n; i++) {
+        pop += __builtin_popcountll(b->cells[i]);
+    }
+    return pop;
+}
+
+ // Returns row y of src, or the zero row if it's off the edge and we're not
+ // wrapping.
+static inline const uint64_t* row_at (const Board* b, const uint64_t* src, int y) {
+    if (y < 0) {
+        if (!b->wrap) return b->zero;
+        y += b->height;
+    }
+    else if (y >= b->height) {
+        if (!b->wrap) return b->zero;
+        y -= b->height;
+    }
+    return &src[(size_t)y * b->words];
+}
+
+ // Under a Generations rule, cells that stop surviving start dying instead
+ // of going straight to dead, and can't be born again until they finish.
+ // This runs after the Life-like step of row y, fixing up its result.
+static void step_ages (Board* b, int y, int j0, int j1) {
+    const uint64_t* mid = &b->cells[(size_t)y * b->words];
+    uint64_t* out = &b->next[(size_t)y * b->words];
+    int start = rule.states - 2;
+    int j, p;
+    for (j = j0; j < j1; j++) {
+        uint64_t busy = 0;
+        for (p = 0; p < b->age_planes; p++) busy |= age_plane(b, p, y)[j];
+        out[j] &= mid[j] | ~busy;
+        uint64_t dying = mid[j] & ~out[j];
+         // Count down the dying cells, and start the newly dying ones.
+        uint64_t borrow = busy;
+        for (p = 0; p < b->age_planes; p++) {
+            uint64_t* a = &age_plane(b, p, y)[j];
+            uint64_t old = *a;
+            *a = (old ^ borrow) | (start >> p & 1 ? dying : 0);
+            borrow &= ~old;
+        }
+    }
+}
+
+void step_tile (Board* b, int y0, int y1, int j0, int j1) {
+    int y;
+    if (rule.radius > 1 || rule.middle) {
+        ltl_tile(b, y0, y1, j0, j1);
+    }
+    else {
+        for (y = y0; y < y1; y++) {
+            step_row(b,
+                row_at(b, b->cells, y + 1),
+                row_at(b, b->cells, y),
+                row_at(b, b->cells, y - 1),
+                &b->next[(size_t)y * b->words], j0, j1
+            );
+        }
+    }
+    if (b->age_planes) {
+        for (y = y0; y < y1; y++) step_ages(b, y, j0, j1);
+    }
+    if (stats_on) tile_stats(b, y0, y1, j0, j1);
+     // The sparse engine's skipped tiles can change too (a blinker flips
+     // back to the generation before last), so only the tiled engine's
+     // deltas add up to the board's.
+    if (period_on && engine->step == board_step) tile_hash(b, y0, y1, j0, j1);
+}
+
+ // Makes the generation just computed into next the current one.
+void board_swap (Board* b) {
+    uint64_t* tmp = b->cells;
+    b->cells = b->next;
+    b->next = tmp;
+    b->generation++;
+    if (stats_on) stats_latch(b);
+    if (period_on) period_latch(b);
+}
+
+uint64_t board_population_of (Board* b) {
+    return board_population(b);
+}
+
+Engine engines [] = {
+    {"tiled", board_step, board_population_of, NULL},
+    {"sparse", sparse_step, board_population_of, sparse_report},
+    {"hashlife", hashlife_step, hashlife_population, hashlife_report},
+    {"infinite", infinite_step, infinite_population, infinite_report},
+    {"packed", packed_step, board_population_of, NULL},
+    {"blocked", blocked_step, board_population_of, NULL},
+    {NULL, NULL, NULL, NULL}
+};
+const Engine* engine = &engines[0];
+
+void select_engine (const char* name) {
+    Engine* e;
+    for (e = engines; e->name; e++) {
+        if (0==strcmp(name, e->name)) {
+            engine = e;
+            return;
+        }
+    }
+    fprintf(stderr, "Unknown engine: %s\n", name);
+    exit(1);
+}
+
+void board_step (Board* b, uint64_t gens) {
+    board_ensure_ages(b);
+    if (threads > 1) {
+        threaded_step(b, gens);
+        return;
+    }
+    while (gens--) {
+        int j;
+         // Go down the board in strips of columns, so that the three input
+         // rows stay in L1 even on very wide boards.
+        for (j = 0; j < b->words; j += STEP_BLOCK_WORDS) {
+            int j1 = j + STEP_BLOCK_WORDS < b->words ? j + STEP_BLOCK_WORDS : b->words;
+            step_tile(b, 0, b->height, j, j1);
+        }
+        board_swap(b);
+    }
+}
@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Larger than Life counts each cell's neighbors in a (2r+1)x(2r+1) box,
+ // which would cost O(r^2) per cell done directly.  Instead each column of
+ // the tile keeps the sum of its 2r+1 cells around the current row, updated
+ // by adding the row entering the box and subtracting the one leaving it,
+ // and each row's counts come from sliding a 2r+1 wide window along those
+ // column sums.  That's a few adds per cell whatever the radius, and the
+ // rule itself is a lookup in its birth and survive tables.
+
+ // Row y, wrapped or off the edge.
+static const uint64_t* ltl_row (const Board* b, int y) {
+    if (y < 0 || y >= b->height) {
+        if (!b->wrap) return b->zero;
+        y = (y % b->height + b->height) % b->height;
+    }
+    return &b->cells[(size_t)y * b->words];
+}
+
+static inline int cell (const uint64_t* row, int x) {
+    return x < 0 ? 0 : row[(unsigned)x / 64] >> ((unsigned)x % 64) & 1;
+}
+
+void ltl_tile (Board* b, int y0, int y1, int j0, int j1) {
+    int r = rule.radius;
+    int x0 = j0 * 64;
+    int x1 = j1 * 64 < b->width ? j1 * 64 : b->width;
+    int n = x1 - x0 + 2 * r;
+    int max = (2 * r + 1) * (2 * r + 1);
+     // Whether a cell lives, by count << 1 | alive, with the cell itself
+     // taken back out of the count for survival if the rule says so.
+    unsigned char* table = malloc(2 * (max + 1));
+     // Board column of each column sum, or -1 past an edge that doesn't wrap
+    int* xs = malloc(n * sizeof(int));
+    uint16_t* sums = calloc(n + 1, sizeof(uint16_t));
+    int i, y, dy;
+    for (i = 0; i <= max; i++) {
+        table[i << 1] = rule.birth[i];
+        table[i << 1 | 1] = rule.middle ? rule.survive[i] : i ? rule.survive[i - 1] : 0;
+    }
+    for (i = 0; i < n; i++) {
+        int x = x0 - r + i;
+        if (x < 0 || x >= b->width) x = b->wrap ? (x % b->width + b->width) % b->width : -1;
+        xs[i] = x;
+    }
+    for (dy = -r; dy <= r; dy++) {
+        const uint64_t* row = ltl_row(b, y0 + dy);
+        for (i = 0; i < n; i++) sums[i] += cell(row, xs[i]);
+    }
+    for (y = y0; y < y1; y++) {
+        const uint64_t* mid = &b->cells[(size_t)y * b->words];
+        uint64_t* out = &b->next[(size_t)y * b->words];
+        unsigned count = 0;
+        for (i = 0; i < 2 * r; i++) count += sums[i];
+        const uint16_t* enter = sums + 2 * r;
+        const uint16_t* leave = sums;
+        int j;
+        for (j = j0; j < j1; j++) {
+            uint64_t m = mid[j], w = 0;
+            int bits = (j + 1) * 64 <= x1 ? 64 : x1 - j * 64;
+            int k;
+            for (k = 0; k < bits; k++) {
+                count += *enter++;
+                w |= (uint64_t)table[count << 1 | (m >> k & 1)] << k;
+                count -= *leave++;
+            }
+            out[j] = w;
+        }
+        if (y + 1 < y1) {
+            const uint64_t* add = ltl_row(b, y + r + 1);
+            const uint64_t* sub = ltl_row(b, y - r);
+            for (i = 0; i < n; i++) sums[i] += cell(add, xs[i]) - cell(sub, xs[i]);
+        }
+    }
+    free(table);
+    free(xs);
+    free(sums);
+}
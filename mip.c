@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // A pyramid of live counts for drawing zoomed out views.  Level 0 counts
+ // blocks of MIP_BASE x MIP_BASE cells and each level above sums 2 x 2
+ // blocks of the one below.  Updates compare the cells with a copy of what
+ // was last counted, recount only the blocks whose words changed, and
+ // carry the changes up through lists of dirty blocks, so a board that is
+ // mostly still costs a pass of word compares and little else.  Drawing
+ // reads one block per pixel from the level just finer than a pixel, so it
+ // costs as much as the window whatever the size of the board.
+
+typedef struct MipLevel {
+    int across;  // Blocks per row
+    int down;
+    int side;  // Cells a side per block
+    uint32_t* counts;
+    unsigned char* dirty;
+    int* todo;  // Blocks with dirty set
+    int ntodo;
+} MipLevel;
+
+MipLevel mip [32];
+int mip_levels;
+int mip_width, mip_height, mip_words;
+uint64_t* mip_shadow;  // The cells as last counted
+
+static void mip_fit (int width, int height, int words) {
+    if (width == mip_width && height == mip_height && mip_shadow) return;
+    int k;
+    for (k = 0; k < mip_levels; k++) {
+        free(mip[k].counts);
+        free(mip[k].dirty);
+        free(mip[k].todo);
+    }
+    free(mip_shadow);
+    mip_width = width;
+    mip_height = height;
+    mip_words = words;
+    mip_shadow = alloc_words((size_t)words * height);
+    int side = MIP_BASE;
+    for (k = 0; k < 32; k++, side *= 2) {
+        MipLevel* l = &mip[k];
+        l->side = side;
+        l->across = (width + side - 1) / side;
+        l->down = (height + side - 1) / side;
+        size_t n = (size_t)l->across * l->down;
+        l->counts = calloc(n, sizeof(uint32_t));
+        l->dirty = calloc(n, 1);
+        l->todo = malloc(n * sizeof(int));
+        l->ntodo = 0;
+        if (l->across == 1 && l->down == 1) break;
+    }
+    mip_levels = k + 1;
+}
+
+static void mark (int k, int bx, int by) {
+    MipLevel* l = &mip[k];
+    int i = by * l->across + bx;
+    if (!l->dirty[i]) {
+        l->dirty[i] = 1;
+        l->todo[l->ntodo++] = i;
+    }
+}
+
+ // Each byte of the result is the number of bits set in that byte of x.
+static uint64_t byte_counts (uint64_t x) {
+    x = x - (x >> 1 & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + (x >> 2 & 0x3333333333333333ull);
+    return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+}
+
+void mip_update (const uint64_t* cells, int width, int height, int words) {
+    mip_fit(width, height, words);
+    MipLevel* l0 = &mip[0];
+    int band, j, y, k, i;
+    for (band = 0; band < l0->down; band++) {
+        int y0 = band * MIP_BASE;
+        int y1 = y0 + MIP_BASE < height ? y0 + MIP_BASE : height;
+        for (j = 0; j < words; j++) {
+            int changed = 0;
+            for (y = y0; y < y1; y++) {
+                changed |= cells[(size_t)y * words + j] != mip_shadow[(size_t)y * words + j];
+            }
+            if (!changed) continue;
+             // Eight blocks share the word, and a byte of the sum never
+             // passes 64, so they're counted side by side.
+            uint64_t sums = 0;
+            for (y = y0; y < y1; y++) {
+                uint64_t w = cells[(size_t)y * words + j];
+                mip_shadow[(size_t)y * words + j] = w;
+                sums += byte_counts(w);
+            }
+            for (i = 0; i < 8 && j * 8 + i < l0->across; i++) {
+                l0->counts[band * l0->across + j * 8 + i] = sums >> (8 * i) & 0xff;
+                if (mip_levels > 1) mark(1, (j * 8 + i) / 2, band / 2);
+            }
+        }
+    }
+    for (k = 1; k < mip_levels; k++) {
+        MipLevel* l = &mip[k];
+        MipLevel* below = &mip[k - 1];
+        for (i = 0; i < l->ntodo; i++) {
+            int b = l->todo[i];
+            int bx = b % l->across, by = b / l->across;
+            uint32_t sum = 0;
+            int cx, cy;
+            for (cy = by * 2; cy < by * 2 + 2 && cy < below->down; cy++) {
+                for (cx = bx * 2; cx < bx * 2 + 2 && cx < below->across; cx++) {
+                    sum += below->counts[cy * below->across + cx];
+                }
+            }
+            l->counts[b] = sum;
+            l->dirty[b] = 0;
+            if (k + 1 < mip_levels) mark(k + 1, bx / 2, by / 2);
+        }
+        l->ntodo = 0;
+    }
+}
+
+ // Draws a pw x ph density map, bottom row first, of the view whose bottom
+ // left corner is at cell x0, y0 with each pixel sx by sy cells.
+void mip_render (unsigned char* out, int pw, int ph, double x0, double y0, double sx, double sy) {
+    double s = sx < sy ? sx : sy;
+    int k = 0;
+    while (k + 1 < mip_levels && mip[k + 1].side <= s) k++;
+    MipLevel* l = &mip[k];
+    int px, py;
+    for (py = 0; py < ph; py++) {
+        double cy = y0 + (py + 0.5) * sy;
+        int by = cy < 0 ? -1 : (int)(cy / l->side);
+        for (px = 0; px < pw; px++) {
+            double cx = x0 + (px + 0.5) * sx;
+            int bx = cx < 0 ? -1 : (int)(cx / l->side);
+            unsigned char v = 0;
+            if (bx >= 0 && bx < l->across && by >= 0 && by < l->down) {
+                int w = mip_width - bx * l->side < l->side ? mip_width - bx * l->side : l->side;
+                int h = mip_height - by * l->side < l->side ? mip_height - by * l->side : l->side;
+                v = (uint64_t)l->counts[by * l->across + bx] * 255 / ((uint64_t)w * h);
+            }
+            out[(size_t)py * pw + px] = v;
+        }
+    }
+}
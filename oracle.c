@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "golsh.h"
+
+ // Checks every engine and kernel against a reference stepper that does
+ // nothing clever: each cell counts its neighbors one by one and looks its
+ // fate up in the rule's tables.  Boards of awkward sizes, wrapping and
+ // not, are filled with a soup or with cells only along their edges, and
+ // each engine steps them a generation at a time and then in growing jumps,
+ // its board hash compared against the reference's after every call.  The
+ // unbounded engines are checked against a reference board padded wide
+ // enough that nothing can reach its edge.
+ //
+ // Prints each divergence with the first cell that differs, and exits 1 if
+ // there were any.
+
+int width, height, window_width, window_height, fullscreen, paused, trails;
+int wrap = 1;
+float fps;
+int seed = 1;
+
+int nthreads = 2;
+int verbose = 0;
+
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct Variant {
+    const char* name;
+    const char* engine;
+    long long block_gens;
+    int procs;  // Through run_stripes if more than 1
+    const char* halo;
+    int unbounded;
+} Variant;
+
+static const Variant variants [] = {
+    {"tiled", "tiled", 16, 1, "shm", 0},
+    {"sparse", "sparse", 16, 1, "shm", 0},
+    {"packed", "packed", 16, 1, "shm", 0},
+    {"blocked", "blocked", 16, 1, "shm", 0},
+    {"blocked/5", "blocked", 5, 1, "shm", 0},
+    {"stripes/3", "tiled", 16, 3, "shm", 0},
+    {"stripes/2 socket", "tiled", 16, 2, "socket", 0},
+    {"stripes/3 blocked/5", "blocked", 5, 3, "shm", 0},
+    {"hashlife", "hashlife", 16, 1, "shm", 1},
+    {"infinite", "infinite", 16, 1, "shm", 1},
+};
+#define VARIANTS (int)(sizeof variants / sizeof variants[0])
+
+static const char* rules [] = {
+    "B3/S23", "B36/S23", "B3678/S34678", "B2/S", "B1357/S1357", "B35/S236",
+    "B2/S345/C4", "R2,C0,M1,S5..9,B7..8,NM", "R3,C3,M0,S12..20,B13..16,NM",
+};
+#define RULES (int)(sizeof rules / sizeof rules[0])
+
+static const int sizes [][2] = {{64, 64}, {63, 17}, {65, 5}, {130, 67}, {200, 3}, {7, 129}};
+#define SIZES (int)(sizeof sizes / sizeof sizes[0])
+
+static const char* setups [] = {"soup", "edges"};
+#define SETUPS (int)(sizeof setups / sizeof setups[0])
+
+ // Sixteen single generations, then jumps of the Fibonacci numbers.
+static const int jumps [] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 3, 5, 8, 13, 21, 34};
+#define JUMPS (int)(sizeof jumps / sizeof jumps[0])
+
+uint64_t fresh_edits;
+
+ // Marks b as changed from anything an engine may have cached about the
+ // board last at its address.
+static void fresh (Board* b) {
+    b->edits = ++fresh_edits << 32;
+}
+
+static void copy_board (Board* to, const Board* from) {
+    if (rule.states > 2) board_ensure_ages(to);
+    memcpy(to->cells, from->cells, (size_t)from->words * from->height * sizeof(uint64_t));
+    if (from->age_planes) {
+        memcpy(to->ages, from->ages, (size_t)from->age_planes * from->words * from->height * sizeof(uint64_t));
+    }
+    to->generation = from->generation;
+    fresh(to);
+}
+
+ // The reference's board, a byte a cell: 0 dead, 1 alive, and 1 + n for
+ // a dying cell with n steps left.
+typedef struct Grid {
+    int width;
+    int height;
+    int wrap;
+    unsigned char* cells;
+    unsigned char* next;
+    uint64_t generation;
+} Grid;
+
+ // A grid holding b with a margin of dead cells all around.
+static Grid* grid_from_board (const Board* b, int margin) {
+    Grid* g = malloc(sizeof(Grid));
+    g->width = b->width + 2 * margin;
+    g->height = b->height + 2 * margin;
+    g->wrap = margin ? 0 : b->wrap;
+    g->cells = calloc((size_t)g->width * g->height, 1);
+    g->next = calloc((size_t)g->width * g->height, 1);
+    g->generation = b->generation;
+    int x, y;
+    for (y = 0; y < b->height; y++) {
+        for (x = 0; x < b->width; x++) {
+            int age = b->age_planes ? board_get_age(b, x, y) : 0;
+            g->cells[(size_t)(y + margin) * g->width + x + margin] = board_get(b, x, y) ? 1 : age ? 1 + age : 0;
+        }
+    }
+    return g;
+}
+
+static void grid_free (Grid* g) {
+    free(g->cells);
+    free(g->next);
+    free(g);
+}
+
+ // The window of g at margin, margin, as a board the size of b.
+static Board* grid_window (const Grid* g, const Board* b, int margin) {
+    Board* w = board_new(b->width, b->height, b->wrap);
+    if (rule.states > 2) board_ensure_ages(w);
+    int x, y;
+    for (y = 0; y < w->height; y++) {
+        for (x = 0; x < w->width; x++) {
+            int c = g->cells[(size_t)(y + margin) * g->width + x + margin];
+            if (c == 1) board_set(w, x, y, 1);
+            else if (c > 1) board_set_age(w, x, y, c - 1);
+        }
+    }
+    w->generation = g->generation;
+    return w;
+}
+
+static void grid_step (Grid* g) {
+    int w = g->width, h = g->height, r = rule.radius;
+    int x, y, dx, dy;
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            int count = 0;
+            if (x >= r && x < w - r && y >= r && y < h - r) {
+                for (dy = -r; dy <= r; dy++) {
+                    const unsigned char* row = &g->cells[(size_t)(y + dy) * w + x];
+                    for (dx = -r; dx <= r; dx++) count += row[dx] == 1;
+                }
+                if (!rule.middle) count -= g->cells[(size_t)y * w + x] == 1;
+            }
+            else for (dy = -r; dy <= r; dy++) {
+                int ny = y + dy;
+                if (ny < 0 || ny >= h) {
+                    if (!g->wrap) continue;
+                    ny = (ny % h + h) % h;
+                }
+                const unsigned char* row = &g->cells[(size_t)ny * w];
+                for (dx = -r; dx <= r; dx++) {
+                    int nx = x + dx;
+                    if (nx < 0 || nx >= w) {
+                        if (!g->wrap) continue;
+                        nx = (nx % w + w) % w;
+                    }
+                    if ((dx || dy) || rule.middle) count += row[nx] == 1;
+                }
+            }
+            int c = g->cells[(size_t)y * w + x];
+            int n;
+            if (c == 1) n = rule.survive[count] ? 1 : rule.states > 2 ? rule.states - 1 : 0;
+            else if (c > 1) n = c - 1 > 1 ? c - 1 : 0;
+            else n = rule.birth[count];
+            g->next[(size_t)y * w + x] = n;
+        }
+    }
+    unsigned char* t = g->cells;
+    g->cells = g->next;
+    g->next = t;
+    g->generation++;
+}
+
+static void fill (Board* b, const char* setup, int case_seed) {
+    uint64_t state = case_seed * 0x9e3779b97f4a7c15ull + 1;
+    int x, y;
+    for (y = 0; y < b->height; y++) {
+        for (x = 0; x < b->width; x++) {
+            int edge = x < 3 || y < 3 || x >= b->width - 3 || y >= b->height - 3;
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            int on = (state >> 40) % 100 < (edge ? 50 : 35);
+            if (0==strcmp(setup, "edges") && !edge) on = 0;
+            if (on) board_set(b, x, y, 1);
+        }
+    }
+}
+
+ // The reference boards after each jump from start, on the board itself or,
+ // for the unbounded engines, in a universe padded wide enough that nothing
+ // can come back from its edges, seen through the board's window.
+static void reference_run (Board** out, const Board* start, int unbounded) {
+    int total = 0, i, n;
+    for (i = 0; i < JUMPS; i++) total += jumps[i];
+    int margin = unbounded ? total * rule.radius + 2 : 0;
+    Grid* g = grid_from_board(start, margin);
+    for (i = 0; i < JUMPS; i++) {
+        for (n = 0; n < jumps[i]; n++) grid_step(g);
+        out[i] = grid_window(g, start, margin);
+    }
+    grid_free(g);
+}
+
+static void report_difference (const Board* got, const Board* want) {
+    int x, y;
+    for (y = 0; y < want->height; y++) {
+        for (x = 0; x < want->width; x++) {
+            int g = board_get(got, x, y), w = board_get(want, x, y);
+            int ga = got->age_planes ? board_get_age(got, x, y) : 0;
+            int wa = want->age_planes ? board_get_age(want, x, y) : 0;
+            if (g != w || ga != wa) {
+                printf("    first at %d, %d: %s where the reference has %s\n", x, y,
+                    g ? "alive" : ga ? "dying" : "dead", w ? "alive" : wa ? "dying" : "dead"
+                );
+                return;
+            }
+        }
+    }
+    printf("    (cells agree; the hashes differ in bits past the board)\n");
+}
+
+ // Returns 1 if the variant matches the reference all the way.
+static int check (const Variant* v, const Board* start, Board** want, const char* setup, int case_seed) {
+    select_engine(v->engine);
+    block_gens = v->block_gens;
+    procs = v->procs;
+    halo_transport = v->halo;
+    Board* b = board_new(start->width, start->height, start->wrap);
+    copy_board(b, start);
+    int i, ok = 1;
+    for (i = 0; i < JUMPS && ok; i++) {
+        if (v->procs > 1) run_stripes(b, jumps[i], 1);
+        else engine->step(b, jumps[i]);
+        if (b->generation != want[i]->generation) {
+            printf("FAIL %s, %s kernel: rule %s, %dx%d %s, %s %d: at generation %llu after a jump of %d, wanted %llu\n",
+                v->name, kernel->name, rule.name, b->width, b->height, b->wrap ? "wrapping" : "not wrapping",
+                setup, case_seed, (unsigned long long)b->generation, jumps[i], (unsigned long long)want[i]->generation
+            );
+            ok = 0;
+        }
+        else if (board_hash(b) != board_hash(want[i])) {
+            printf("FAIL %s, %s kernel: rule %s, %dx%d %s, %s %d: generation %llu differs after a jump of %d\n",
+                v->name, kernel->name, rule.name, b->width, b->height, b->wrap ? "wrapping" : "not wrapping",
+                setup, case_seed, (unsigned long long)b->generation, jumps[i]
+            );
+            report_difference(b, want[i]);
+            ok = 0;
+        }
+    }
+    end_stripes(b);
+    board_free(b);
+    procs = 1;
+    return ok;
+}
+
+ // Stripes with rows wider than a socket's buffer, against the tiled engine,
+ // which the reference has already vouched for.  Returns 1 if they match.
+static int check_wide (const char* engine_name, const char* halo) {
+    select_rule("B3/S23");
+    select_engine("tiled");
+    Board* start = board_new(1 << 22, 8, 1);
+    fill(start, "soup", seed);
+    Board* want = board_new(start->width, start->height, start->wrap);
+    copy_board(want, start);
+    engine->step(want, 5);
+    select_engine(engine_name);
+    procs = 2;
+    halo_transport = halo;
+    Board* b = board_new(start->width, start->height, start->wrap);
+    copy_board(b, start);
+     // Left with the workers in between, and gathered by end_stripes.
+    run_stripes(b, 2, 0);
+    run_stripes(b, 3, 0);
+    end_stripes(b);
+    int ok = board_hash(b) == board_hash(want);
+    if (!ok) {
+        printf("FAIL stripes/2 %s over %s: %dx%d rows differ at generation %llu\n", engine_name, halo,
+            b->width, b->height, (unsigned long long)b->generation
+        );
+        report_difference(b, want);
+    }
+    else if (verbose) printf("ok   stripes/2 %s over %s: %dx%d\n", engine_name, halo, b->width, b->height);
+    procs = 1;
+    board_free(start);
+    board_free(want);
+    board_free(b);
+    return ok;
+}
+
+int opt_i (char* arg, size_t len, const char* prefix, int* var) {
+    if (0==strncmp(arg, prefix, len)) {
+        *var = atoi(arg+len);
+        return 1;
+    }
+    return 0;
+}
+int opt_b (char* arg, const char* name, int* var) {
+    if (0==strcmp(arg, name)) {
+        *var = 1;
+        return 1;
+    }
+    return 0;
+}
+
+int main (int argc, char** argv) {
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (opt_i(argv[i], 9, "-threads=", &nthreads)) continue;
+        if (opt_i(argv[i], 6, "-seed=", &seed)) continue;
+        if (opt_b(argv[i], "-v", &verbose)) continue;
+        fprintf(stderr, "Unrecognized option: %s\n", argv[i]);
+        exit(1);
+    }
+    start_threads(nthreads);
+     // Little enough that forking for the stripes stays cheap, and the
+     // HashLife collector gets some work.
+    hashlife_mem = 64;
+    int runs = 0, failures = 0;
+    int r, s, w, u, v;
+    Board* want [JUMPS];
+    Board* want_unbounded [JUMPS];
+    for (r = 0; r < RULES; r++) {
+        select_rule(rules[r]);
+        int life_like = rule.states == 2 && rule.radius == 1 && !rule.middle;
+        for (s = 0; s < SIZES; s++) {
+            for (w = 0; w < 2; w++) {
+                for (u = 0; u < SETUPS; u++) {
+                    int case_seed = seed + (r * SIZES + s) * 4 + w * 2 + u;
+                    Board* start = board_new(sizes[s][0], sizes[s][1], w);
+                    fill(start, setups[u], case_seed);
+                    reference_run(want, start, 0);
+                    if (life_like) reference_run(want_unbounded, start, 1);
+                    const Kernel* k;
+                    const Kernel* first = NULL;
+                    for (k = kernels; k->name; k++) {
+                        if (!kernel_supported(k)) continue;
+                        if (!first) first = k;
+                        kernel = k;
+                        for (v = 0; v < VARIANTS; v++) {
+                             // Only the tiled engine runs the wider rules.
+                             // The kernels don't reach into the unbounded
+                             // engines, and the stripes only need checking
+                             // once, so those run with the first kernel.
+                            if (!life_like && (strcmp(variants[v].engine, "tiled") || variants[v].procs > 1)) continue;
+                            if ((variants[v].unbounded || variants[v].procs > 1) && k != first) continue;
+                            int ok = check(&variants[v], start,
+                                variants[v].unbounded ? want_unbounded : want, setups[u], case_seed
+                            );
+                            runs++;
+                            failures += !ok;
+                            if (verbose && ok) {
+                                printf("ok   %s, %s kernel: rule %s, %dx%d %s, %s %d\n", variants[v].name, k->name,
+                                    rule.name, start->width, start->height, w ? "wrapping" : "not wrapping",
+                                    setups[u], case_seed
+                                );
+                            }
+                        }
+                    }
+                    for (i = 0; i < JUMPS; i++) {
+                        board_free(want[i]);
+                        if (life_like) board_free(want_unbounded[i]);
+                    }
+                    board_free(start);
+                }
+            }
+        }
+        fflush(stdout);
+    }
+    select_kernel(NULL);
+    const char* halos [] = {"shm", "socket"};
+    for (i = 0; i < 2; i++) {
+        runs += 2;
+        failures += !check_wide("tiled", halos[i]);
+        failures += !check_wide("blocked", halos[i]);
+    }
+    printf("%d runs against the reference, %d failed\n", runs, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "golsh.h"
+
+ // The packed GPU mode keeps 32 cells in each texel of an R32UI texture,
+ // bit k of texel i in a row being cell 32*i + k, which is the board's own
+ // layout read as 32-bit words.  The step is the same bit-sliced adder as
+ // LIFE_WORD, on one uint per fragment.  The functions below are written
+ // in the common ground of C and GLSL 1.30 and kept in a macro, so that the
+ // C here and the shader run_display compiles are built from one text, and
+ // the packed engine, running them over the board on the CPU, checks the
+ // packing and edge handling against the other engines without a GPU.
+typedef uint32_t uint;
+
+ // Each texel is stepped from the texels around it: l and r are those to
+ // the left and right (or across the edge when wrapping, or 0), tail is
+ // how many of m's bits are cells and ltail the same for l.
+#define PACKED_FUNCS \
+uint packed_west (uint m, uint l, int ltail) { \
+    return (m << 1) | ((l >> (ltail - 1)) & 1u); \
+} \
+uint packed_east (uint m, uint r, int tail) { \
+    return (m >> 1) | ((r & 1u) << (tail - 1)); \
+} \
+uint packed_texel ( \
+    uint ul, uint u, uint ur, uint ml, uint m, uint mr, uint dl, uint d, uint dr, \
+    int tail, int ltail, uint birth, uint survive \
+) { \
+    uint uw = packed_west(u, ul, ltail), ue = packed_east(u, ur, tail); \
+    uint mw = packed_west(m, ml, ltail), me = packed_east(m, mr, tail); \
+    uint dw = packed_west(d, dl, ltail), de = packed_east(d, dr, tail); \
+    uint s1 = uw ^ u ^ ue; \
+    uint c1 = (uw & u) | (ue & (uw ^ u)); \
+    uint s2 = mw ^ me ^ dw; \
+    uint c2 = (mw & me) | (dw & (mw ^ me)); \
+    uint s3 = d ^ de; \
+    uint c3 = d & de; \
+    uint ones = s1 ^ s2 ^ s3; \
+    uint k = (s1 & s2) | (s3 & (s1 ^ s2)); \
+    uint t = c1 ^ c2 ^ c3; \
+    uint f1 = (c1 & c2) | (c3 & (c1 ^ c2)); \
+    uint twos = t ^ k; \
+    uint fours = f1 ^ (t & k); \
+    uint eights = f1 & t & k; \
+    uint next = 0u; \
+    for (int c = 0; c <= 8; c++) { \
+        uint is = ((c & 1) != 0 ? ones : ~ones) & ((c & 2) != 0 ? twos : ~twos) \
+            & ((c & 4) != 0 ? fours : ~fours) & ((c & 8) != 0 ? eights : ~eights); \
+        uint live = (((birth >> c) & 1u) != 0u ? ~m : 0u) | (((survive >> c) & 1u) != 0u ? m : 0u); \
+        next |= is & live; \
+    } \
+    return tail == 32 ? next : next & ((1u << tail) - 1u); \
+}
+#define PACKED_TEXT(...) #__VA_ARGS__
+#define PACKED_STRING(...) PACKED_TEXT(__VA_ARGS__)
+
+PACKED_FUNCS
+const char* packed_glsl = PACKED_STRING(PACKED_FUNCS);
+
+ // Reads texel x of row y of cells the way the shader's texelFetch does,
+ // giving 0 past the edges unless wrapping.
+static uint fetch (const uint* cells, int stride, int across, int height, int wrap, int x, int y) {
+    if (wrap) {
+        x = (x + across) % across;
+        y = (y + height) % height;
+    }
+    else if (x < 0 || x >= across || y < 0 || y >= height) return 0;
+    return cells[(size_t)y * stride + x];
+}
+
+#define AT(dx, dy) fetch(in, stride, across, b->height, b->wrap, x + (dx), y + (dy))
+void packed_step (Board* b, uint64_t gens) {
+    int across = (b->width + 31) / 32;
+    int stride = b->words * 2;
+    int last_tail = b->width - (across - 1) * 32;
+    uint birth = rule.birth_mask, survive = rule.survive_mask;
+    while (gens--) {
+        const uint* in = (const uint*)b->cells;
+        uint* out = (uint*)b->next;
+        int x, y;
+        for (y = 0; y < b->height; y++) {
+            for (x = 0; x < across; x++) {
+                int tail = x == across - 1 ? last_tail : 32;
+                int ltail = x == 0 ? last_tail : 32;
+                out[(size_t)y * stride + x] = packed_texel(
+                    AT(-1, 1), AT(0, 1), AT(1, 1),
+                    AT(-1, 0), AT(0, 0), AT(1, 0),
+                    AT(-1, -1), AT(0, -1), AT(1, -1),
+                    tail, ltail, birth, survive
+                );
+            }
+        }
+        board_swap(b);
+    }
+}
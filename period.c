@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <string.h>
+#include "golsh.h"
+
+ // The board's hash is the sum over its words of a mix of each word with
+ // its index, so changing a word moves the hash by the difference of two
+ // mixes and no other word needs looking at.  step_tile adds those
+ // differences up for the words it changed, and board_swap applies them
+ // and looks the new hash up among the last PERIOD_HISTORY generations'.
+ // The first match is the first repeated state, so the generation it
+ // matched is exactly where the cycle starts.  Anything else that changes
+ // the cells bumps edits, after which the hash is recomputed in full, as
+ // it is at every swap for engines that don't step through step_tile and
+ // for Generations rules, whose dying cells the tiles don't hash.
+ //
+ // The blocked engine swaps only every block_gens generations, so it adds
+ // up the differences for each generation in between as its blocks step
+ // through them, and period_between records those generations' hashes
+ // before the swap.  A match across a gap, where a batch of generations
+ // went by unhashed, shows the board repeats but not where the cycle
+ // starts, so it's passed over until a gapless one comes round.
+#define PERIOD_HISTORY 256
+
+int period_on;
+int stop_on_stable;
+
+uint64_t hashes [PERIOD_HISTORY];  // Oldest first from hashed_at, a ring
+uint64_t hash_gens [PERIOD_HISTORY];  // The generation of each
+int hashed_at;
+int nhashed;
+uint64_t hashed_to;  // One past the newest
+uint64_t gapless_from;  // Generations from here on were all hashed
+Board* period_board;
+
+static inline uint64_t mix_word (uint64_t i, uint64_t w) {
+    uint64_t z = (w ^ (i + 1) * 0x9e3779b97f4a7c15ull) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ z >> 32) * 0x94d049bb133111ebull;
+    return z ^ z >> 29;
+}
+
+uint64_t board_hash (const Board* b) {
+    size_t i, n = (size_t)b->words * b->height;
+    uint64_t h = 0;
+    for (i = 0; i < n; i++) h += mix_word(i, b->cells[i]);
+    if (b->age_planes) {
+        const uint64_t* ages = b->ages;
+        for (i = 0; i < n * b->age_planes; i++) h += mix_word(n + i, ages[i]);
+    }
+    return h;
+}
+
+typedef uint64_t hash_vec __attribute__((vector_size(64)));
+
+ // mix_word on eight words at once, given (i + 1) * 0x9e3779b97f4a7c15
+ // for each as its key.  It's a macro so that it takes on the target of the
+ // function it's used in.
+#define MIX_VEC(z, key, w) do { \
+    z = ((w) ^ (key)) * 0xbf58476d1ce4e5b9ull; \
+    z = (z ^ z >> 32) * 0x94d049bb133111ebull; \
+    z ^= z >> 29; \
+} while (0)
+
+#define HASH_DELTA(name, attr) \
+attr static uint64_t name (const uint64_t* in, const uint64_t* out, uint64_t at, int n) { \
+    const hash_vec lanes = {1, 2, 3, 4, 5, 6, 7, 8}; \
+    const hash_vec s4 = {4, 5, 6, 7, 0, 1, 2, 3}; \
+    const hash_vec s2 = {2, 3, 0, 1, 6, 7, 4, 5}; \
+    const hash_vec s1 = {1, 0, 3, 2, 5, 4, 7, 6}; \
+    hash_vec sum = {0}; \
+    hash_vec key = (lanes + at) * 0x9e3779b97f4a7c15ull; \
+    uint64_t delta = 0; \
+    int j, k; \
+    for (j = 0; j + 8 <= n; j += 8, key += 8 * 0x9e3779b97f4a7c15ull) { \
+        hash_vec was, now, x, zw, zn; \
+        memcpy(&was, in + j, sizeof was); \
+        memcpy(&now, out + j, sizeof now); \
+        x = was ^ now; \
+        x |= __builtin_shuffle(x, s4); \
+        x |= __builtin_shuffle(x, s2); \
+        x |= __builtin_shuffle(x, s1); \
+        if (!x[0]) continue; \
+        MIX_VEC(zw, key, was); \
+        MIX_VEC(zn, key, now); \
+        sum += (zn - zw) & (hash_vec)(was != now); \
+    } \
+    for (; j < n; j++) \
+        if (in[j] != out[j]) delta += mix_word(at + j, out[j]) - mix_word(at + j, in[j]); \
+    for (k = 0; k < 8; k++) delta += sum[k]; \
+    return delta; \
+}
+ // Eight words are compared at once and mixed only if one of them changed,
+ // with the unchanged ones masked out of the sum.
+HASH_DELTA(hash_delta_avx512, __attribute__((target("avx512f,avx512dq"))))
+HASH_DELTA(hash_delta_plain, )
+
+ // How much the hash moves by when the n words from index at change from
+ // in to out.
+uint64_t hash_delta (const uint64_t* in, const uint64_t* out, uint64_t at, int n) {
+    static int has_avx512 = -1;
+    if (has_avx512 < 0) has_avx512 = __builtin_cpu_supports("avx512dq");
+    return has_avx512 ? hash_delta_avx512(in, out, at, n) : hash_delta_plain(in, out, at, n);
+}
+
+void tile_hash (Board* b, int y0, int y1, int j0, int j1) {
+    uint64_t delta = 0;
+    int y;
+    for (y = y0; y < y1; y++) {
+        size_t row = (size_t)y * b->words;
+        delta += hash_delta(&b->cells[row + j0], &b->next[row + j0], row + j0, j1 - j0);
+    }
+    if (delta) __atomic_fetch_add(&b->hash_delta, delta, __ATOMIC_RELAXED);
+}
+
+static void forget (Board* b) {
+    period_board = b;
+    hashed_at = nhashed = 0;
+    hashed_to = gapless_from = b->generation;
+    b->period = 0;
+}
+
+ // Records the hash of the board's current generation, checking it against
+ // those of the PERIOD_HISTORY generations before.  Going back in time
+ // starts the history over.
+static void record (Board* b) {
+    if (b != period_board || b->generation < hashed_to) forget(b);
+    if (b->generation != hashed_to) gapless_from = b->generation;
+    while (nhashed && hash_gens[hashed_at] + PERIOD_HISTORY < b->generation) {
+        hashed_at = (hashed_at + 1) % PERIOD_HISTORY;
+        nhashed--;
+    }
+    if (!b->period) {
+        int i;
+        for (i = nhashed; i-- > 0;) {
+            int k = (hashed_at + i) % PERIOD_HISTORY;
+            if (hashes[k] != b->hash) continue;
+            if (hash_gens[k] >= gapless_from) {
+                b->period = b->generation - hash_gens[k];
+                b->period_start = hash_gens[k];
+            }
+            break;
+        }
+    }
+    if (nhashed == PERIOD_HISTORY) {
+        hashed_at = (hashed_at + 1) % PERIOD_HISTORY;
+        nhashed--;
+    }
+    int k = (hashed_at + nhashed++) % PERIOD_HISTORY;
+    hashes[k] = b->hash;
+    hash_gens[k] = b->generation;
+    hashed_to = b->generation + 1;
+}
+
+ // Sets the hash, from scratch unless delta says how it moved since the
+ // last generation, and records it.  Edits start the history over, since
+ // the states before them no longer lead to this one.
+static void set_hash (Board* b, int from_delta) {
+    if (b->hash_valid && b->hash_edits != b->edits) forget(b);
+    if (from_delta) b->hash += b->hash_delta;
+    else b->hash = board_hash(b);
+    b->hash_delta = 0;
+    b->hash_valid = 1;
+    b->hash_edits = b->edits;
+    b->hash_generation = b->generation;
+    record(b);
+}
+
+ // For an engine that swaps every n generations: records the hashes of the
+ // n - 1 generations after the board's, from deltas[g], how far each moved
+ // it from the one before, and leaves the last to board_swap.
+void period_between (Board* b, const uint64_t* deltas, int n) {
+    uint64_t generation = b->generation;
+    int g;
+    for (g = 0; g < n - 1; g++) {
+        b->generation++;
+        b->hash_delta = deltas[g];
+        set_hash(b, 1);
+    }
+    b->generation = generation;
+    b->hash_delta = deltas[n - 1];
+}
+
+ // Called by board_swap with the board already at its new generation.
+void period_latch (Board* b) {
+    int deltas = engine->step == board_step || engine->step == blocked_step;
+    set_hash(b, deltas && !b->age_planes && b->hash_valid
+        && b->hash_edits == b->edits && b->hash_generation + 1 == b->generation
+    );
+}
+
+ // Brings the hash up to the board's current generation, for when it was
+ // changed other than by stepping or by an engine that doesn't swap.
+void period_update (Board* b) {
+    if (!period_on) return;
+    if (b->hash_valid && b->hash_edits == b->edits && b->hash_generation == b->generation) return;
+    set_hash(b, 0);
+}
+
+void period_report (Board* b) {
+    period_update(b);
+    if (!b->period) {
+        printf("No repeat within %d generations\n", PERIOD_HISTORY);
+    }
+    else if (b->period == 1) {
+        printf("Still from generation %llu\n", (unsigned long long)b->period_start);
+    }
+    else {
+        printf("Period %llu from generation %llu\n",
+            (unsigned long long)b->period, (unsigned long long)b->period_start
+        );
+    }
+}
@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "golsh.h"
+
+ // -record=DIR writes frames of a headless run as grayscale PNGs named
+ // by generation.  The stepping thread only copies the words of the region
+ // into a spare buffer and queues it; a pool of encoder threads scales it
+ // down, compresses it and writes it out.  Buffers go back to the spares
+ // once written, and when none is spare the frame is dropped and counted
+ // rather than making the simulation wait.
+
+const char* record_dir;
+long long record_every = 1;
+int record_x, record_y, record_w, record_h;  // Region, the whole board if record_w is 0
+int record_scale = 1;  // Cells per pixel across and down
+int record_threads = 2;
+int record_queue = 8;  // Buffers, so frames in flight
+
+typedef struct Shot {
+    uint64_t generation;
+    uint64_t* words;  // The region's rows, from word j0 of each
+    struct Shot* next;
+} Shot;
+
+Shot* spare;
+Shot* queued;
+Shot** queued_end = &queued;
+pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t record_cond = PTHREAD_COND_INITIALIZER;
+pthread_t* encoders;
+int record_stopping;
+int region_j0;
+int region_words;
+uint64_t frames_written;
+uint64_t frames_dropped;
+
+static void put_u32 (unsigned char* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void write_chunk (FILE* f, const char* type, const unsigned char* data, uint32_t len) {
+    unsigned char head [8];
+    put_u32(head, len);
+    memcpy(head + 4, type, 4);
+    uLong crc = crc32(0, (const Bytef*)type, 4);
+    if (len) crc = crc32(crc, data, len);
+    unsigned char tail [4];
+    put_u32(tail, crc);
+    fwrite(head, 1, 8, f);
+    if (len) fwrite(data, 1, len, f);
+    fwrite(tail, 1, 4, f);
+}
+
+ // Scales the shot down to pixels, each the share of its cells alive, and
+ // writes it out, top row first.
+static void encode (Shot* s, unsigned char* raw, unsigned char* packed, uLong packed_cap) {
+    int pw = (record_w + record_scale - 1) / record_scale;
+    int ph = (record_h + record_scale - 1) / record_scale;
+    int px, py, x, y;
+    for (py = 0; py < ph; py++) {
+        unsigned char* line = &raw[(size_t)py * (pw + 1)];
+        line[0] = 0;  // No filter
+        int y1 = record_h - py * record_scale;
+        int y0 = y1 - record_scale > 0 ? y1 - record_scale : 0;
+        for (px = 0; px < pw; px++) {
+            int x0 = px * record_scale;
+            int x1 = x0 + record_scale < record_w ? x0 + record_scale : record_w;
+            int live = 0;
+            for (y = y0; y < y1; y++) {
+                const uint64_t* row = &s->words[(size_t)y * region_words];
+                for (x = x0; x < x1; x++) {
+                    int cx = record_x - region_j0 * 64 + x;
+                    live += row[cx / 64] >> (cx % 64) & 1;
+                }
+            }
+            line[1 + px] = live * 255 / ((x1 - x0) * (y1 - y0));
+        }
+    }
+    uLongf len = packed_cap;
+    if (compress2(packed, &len, raw, (uLong)ph * (pw + 1), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        fprintf(stderr, "Failed to compress frame %llu.\n", (unsigned long long)s->generation);
+        exit(1);
+    }
+    char name [4096];
+    snprintf(name, sizeof name, "%s/%012llu.png", record_dir, (unsigned long long)s->generation);
+    FILE* f = fopen(name, "wb");
+    if (!f) {
+        fprintf(stderr, "Could not open %s for writing.\n", name);
+        exit(1);
+    }
+    static const unsigned char signature [8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    unsigned char ihdr [13];
+    put_u32(ihdr, pw);
+    put_u32(ihdr + 4, ph);
+    ihdr[8] = 8;  // Bits per sample
+    ihdr[9] = 0;  // Grayscale
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    fwrite(signature, 1, 8, f);
+    write_chunk(f, "IHDR", ihdr, 13);
+    write_chunk(f, "IDAT", packed, len);
+    write_chunk(f, "IEND", NULL, 0);
+    if (fclose(f)) {
+        fprintf(stderr, "Failed writing %s.\n", name);
+        exit(1);
+    }
+}
+
+static void* encoder_thread (void* arg) {
+    (void)arg;
+    int pw = (record_w + record_scale - 1) / record_scale;
+    int ph = (record_h + record_scale - 1) / record_scale;
+    uLong raw_len = (uLong)ph * (pw + 1);
+    uLong packed_cap = compressBound(raw_len);
+    unsigned char* raw = malloc(raw_len);
+    unsigned char* packed = malloc(packed_cap);
+    pthread_mutex_lock(&record_mutex);
+    for (;;) {
+        while (!queued && !record_stopping) pthread_cond_wait(&record_cond, &record_mutex);
+        if (!queued) break;
+        Shot* s = queued;
+        queued = s->next;
+        if (!queued) queued_end = &queued;
+        pthread_mutex_unlock(&record_mutex);
+        encode(s, raw, packed, packed_cap);
+        pthread_mutex_lock(&record_mutex);
+        s->next = spare;
+        spare = s;
+        frames_written++;
+    }
+    pthread_mutex_unlock(&record_mutex);
+    free(raw);
+    free(packed);
+    return NULL;
+}
+
+void record_start (const Board* b) {
+    if (!record_dir) return;
+    if (mkdir(record_dir, 0777) && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", record_dir, strerror(errno));
+        exit(1);
+    }
+    if (!record_w) {
+        record_x = record_y = 0;
+        record_w = b->width;
+        record_h = b->height;
+    }
+    if (record_x < 0 || record_y < 0 || record_w < 1 || record_h < 1
+        || record_x + record_w > b->width || record_y + record_h > b->height
+    ) {
+        fprintf(stderr, "The region to record isn't within the %dx%d board.\n", b->width, b->height);
+        exit(1);
+    }
+    if (record_scale < 1) record_scale = 1;
+    if (record_threads < 1) record_threads = 1;
+    if (record_queue < 1) record_queue = 1;
+    if (record_every < 1) record_every = 1;
+    region_j0 = record_x / 64;
+    region_words = (record_x + record_w - 1) / 64 - region_j0 + 1;
+    int i;
+    for (i = 0; i < record_queue; i++) {
+        Shot* s = calloc(1, sizeof(Shot));
+        s->words = alloc_words((size_t)region_words * record_h);
+        s->next = spare;
+        spare = s;
+    }
+    record_stopping = 0;
+    encoders = malloc(record_threads * sizeof(pthread_t));
+    for (i = 0; i < record_threads; i++) {
+        if (pthread_create(&encoders[i], NULL, encoder_thread, NULL)) {
+            fprintf(stderr, "Failed to create an encoder thread.\n");
+            exit(1);
+        }
+    }
+}
+
+ // Queues the board's current generation, or drops it if every buffer is
+ // still being encoded.
+void record_frame (const Board* b) {
+    if (!record_dir) return;
+    pthread_mutex_lock(&record_mutex);
+    Shot* s = spare;
+    if (s) spare = s->next;
+    else frames_dropped++;
+    pthread_mutex_unlock(&record_mutex);
+    if (!s) return;
+    int y;
+    for (y = 0; y < record_h; y++) {
+        memcpy(&s->words[(size_t)y * region_words],
+            &b->cells[(size_t)(record_y + y) * b->words + region_j0],
+            region_words * sizeof(uint64_t)
+        );
+    }
+    s->generation = b->generation;
+    s->next = NULL;
+    pthread_mutex_lock(&record_mutex);
+    *queued_end = s;
+    queued_end = &s->next;
+    pthread_cond_signal(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+ // Waits for the frames in flight to be written.
+void record_finish () {
+    if (!record_dir || !encoders) return;
+    int i;
+    pthread_mutex_lock(&record_mutex);
+    record_stopping = 1;
+    pthread_cond_broadcast(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+    for (i = 0; i < record_threads; i++) pthread_join(encoders[i], NULL);
+    free(encoders);
+    encoders = NULL;
+    while (spare) {
+        Shot* s = spare;
+        spare = s->next;
+        free(s->words);
+        free(s);
+    }
+    printf("Recorded %llu frames to %s, dropped %llu\n",
+        (unsigned long long)frames_written, record_dir, (unsigned long long)frames_dropped
+    );
+}
@@ -0,0 +1,367 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "golsh.h"
+
+ // The parser works on the whole file at once, mapped into memory or read
+ // in large chunks, and decodes runs straight into the board's words.
+
+typedef struct Parser {
+    const char* p;
+    const char* end;
+    char* err;
+    size_t errlen;
+} Parser;
+
+static int fail (Parser* ps, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(ps->err, ps->errlen, fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+static void skip_spaces (Parser* ps) {
+    while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r'))
+        ps->p++;
+}
+
+ // Parses an optionally signed decimal, saturating instead of overflowing.
+static int parse_int (Parser* ps, int64_t* out) {
+    int neg = 0;
+    if (ps->p < ps->end && (*ps->p == '-' || *ps->p == '+')) {
+        neg = *ps->p == '-';
+        ps->p++;
+    }
+    if (ps->p >= ps->end || !isdigit((unsigned char)*ps->p)) return 0;
+    int64_t v = 0;
+    while (ps->p < ps->end && isdigit((unsigned char)*ps->p)) {
+        if (v < INT64_MAX / 16) v = v * 10 + (*ps->p - '0');
+        ps->p++;
+    }
+    *out = neg ? -v : v;
+    return 1;
+}
+
+static const char* line_end (Parser* ps) {
+    const char* nl = memchr(ps->p, '\n', ps->end - ps->p);
+    return nl ? nl : ps->end;
+}
+
+ // Golly's extended header, e.g. "#CXRLE Pos=-3,-2 Gen=100".
+static void parse_cxrle (Parser* ps, RleInfo* info) {
+    const char* eol = line_end(ps);
+    const char* pos = NULL;
+    const char* q;
+    for (q = ps->p; q + 4 <= eol; q++) {
+        if (0==memcmp(q, "Pos=", 4)) {
+            pos = q + 4;
+            break;
+        }
+    }
+    if (pos) {
+        Parser sub = *ps;
+        sub.p = pos;
+        sub.end = eol;
+        int64_t x, y;
+        if (parse_int(&sub, &x) && sub.p < eol && *sub.p++ == ',' && parse_int(&sub, &y)) {
+            info->pos_x = x;
+            info->pos_y = y;
+            info->has_pos = 1;
+        }
+    }
+    ps->p = eol;
+}
+
+ // The "x = 3, y = 3, rule = B3/S23" line.  Fields other than x and y are
+ // optional and unknown ones are ignored.
+static int parse_header (Parser* ps, RleInfo* info) {
+    const char* eol = line_end(ps);
+    int got_x = 0, got_y = 0;
+    while (ps->p < eol) {
+        skip_spaces(ps);
+        const char* key = ps->p;
+        while (ps->p < eol && (isalnum((unsigned char)*ps->p) || *ps->p == '_')) ps->p++;
+        size_t keylen = ps->p - key;
+        skip_spaces(ps);
+        if (!keylen || ps->p >= eol || *ps->p != '=') {
+            return fail(ps, "RLE parse error; malformed header field.");
+        }
+        ps->p++;
+        skip_spaces(ps);
+        if (keylen == 1 && (*key == 'x' || *key == 'y')) {
+            int64_t v;
+            if (!parse_int(ps, &v) || v < 0) {
+                return fail(ps, "RLE parse error; expected a size for %c.", *key);
+            }
+            if (*key == 'x') {
+                info->width = v;
+                got_x = 1;
+            }
+            else {
+                info->height = v;
+                got_y = 1;
+            }
+        }
+        else {
+             // The rule runs to the end of the line, since it may have commas
+             // of its own (as in "B3/S23:T100,100").
+            int is_rule = keylen == 4 && 0==memcmp(key, "rule", 4);
+            const char* val = ps->p;
+            while (ps->p < eol && (is_rule || *ps->p != ',')) ps->p++;
+            const char* val_end = ps->p;
+            while (val_end > val && isspace((unsigned char)val_end[-1])) val_end--;
+            if (is_rule) {
+                size_t n = val_end - val;
+                if (n >= sizeof info->rule) n = sizeof info->rule - 1;
+                memcpy(info->rule, val, n);
+                info->rule[n] = 0;
+            }
+        }
+        skip_spaces(ps);
+        if (ps->p < eol && *ps->p == ',') ps->p++;
+        else if (ps->p < eol && *ps->p != '\n' && !isalpha((unsigned char)*ps->p)) {
+            return fail(ps, "RLE parse error; expected , but got %c.", *ps->p);
+        }
+    }
+    if (!got_x || !got_y) return fail(ps, "RLE parse error; header is missing x or y.");
+    return 0;
+}
+
+ // Turns a cell token into its state: b and . are dead, o and other
+ // letters are alive, and A-X with an optional p-y prefix are the numbered
+ // states of multi-state rules.
+static int parse_state (Parser* ps, int* state) {
+    char c = *ps->p++;
+    if (c == 'b' || c == '.') *state = 0;
+    else if (c >= 'A' && c <= 'X') *state = c - 'A' + 1;
+    else if (c >= 'p' && c <= 'y' && ps->p < ps->end && *ps->p >= 'A' && *ps->p <= 'X') {
+        *state = (c - 'p' + 1) * 24 + (*ps->p++ - 'A' + 1);
+    }
+    else if (isalpha((unsigned char)c)) *state = 1;
+    else return fail(ps, "RLE parse error; unrecognized character %c.", c);
+    return 0;
+}
+
+ // Parses the comments and header, leaving ps at the first run.
+static int parse_preamble (Parser* ps, RleInfo* info) {
+    memset(info, 0, sizeof *info);
+    for (;;) {
+        while (ps->p < ps->end && isspace((unsigned char)*ps->p)) ps->p++;
+        if (ps->p >= ps->end) return fail(ps, "RLE parse error; premature EOF.");
+        if (*ps->p != '#') break;
+        if (ps->end - ps->p >= 6 && 0==memcmp(ps->p, "#CXRLE", 6)) parse_cxrle(ps, info);
+        else ps->p = line_end(ps);
+    }
+    if (*ps->p != 'x') return fail(ps, "RLE parse error; expected x but got %c.", *ps->p);
+    return parse_header(ps, info);
+}
+
+ // Decodes the runs into b with the top left cell at start_x, y.
+static int parse_runs (Parser* ps, Board* b, int64_t start_x, int64_t y) {
+    int64_t x = start_x;
+    uint64_t* row = y >= 0 && y < b->height ? &b->cells[(size_t)y * b->words] : NULL;
+    const char* p = ps->p;
+    const char* end = ps->end;
+    while (p < end) {
+        char c = *p;
+        int64_t run = 1;
+        if (c >= '0' && c <= '9') {
+            run = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (run < INT32_MAX) run = run * 10 + (*p - '0');
+                p++;
+            }
+            if (run > INT32_MAX) run = INT32_MAX;
+            while (p < end && isspace((unsigned char)*p)) p++;
+            if (p >= end || *p == '!') break;
+            c = *p;
+        }
+        if (c == 'o') {
+             // Set the run's bits a word at a time, clipped to the row.
+            p++;
+            if (row && x < b->width && x + run > 0) {
+                int64_t x0 = x < 0 ? 0 : x;
+                int64_t x1 = x + run < b->width ? x + run : b->width;
+                while (x0 < x1) {
+                    int bit = x0 % 64;
+                    int64_t n = 64 - bit < x1 - x0 ? 64 - bit : x1 - x0;
+                    row[x0 / 64] |= (n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1) << bit;
+                    x0 += n;
+                }
+            }
+            if (x < INT32_MAX) x += run;
+        }
+        else if (c == 'b') {
+            p++;
+            if (x < INT32_MAX) x += run;
+        }
+        else if (c == '$') {
+            p++;
+            x = start_x;
+            if (y > INT32_MIN) y -= run;
+            row = y >= 0 && y < b->height ? &b->cells[(size_t)y * b->words] : NULL;
+        }
+        else if (c == '!') {
+            break;
+        }
+        else if (isspace((unsigned char)c)) {
+            p++;
+        }
+        else if (c == '#') {
+            ps->p = p;
+            p = line_end(ps);
+        }
+        else {
+             // Multi-state tokens.  State 1 is alive, and under a
+             // Generations rule the higher states are dying cells with
+             // states - s steps left.
+            int state = 0;
+            ps->p = p;
+            if (parse_state(ps, &state)) return -1;
+            p = ps->p;
+            if (state >= 1 && state < rule.states && row && x < b->width && x + run > 0) {
+                int64_t x0 = x < 0 ? 0 : x;
+                int64_t x1 = x + run < b->width ? x + run : b->width;
+                if (state == 1) board_fill(b, x0, y, x1 - x0, 1);
+                else for (; x0 < x1; x0++) board_set_age(b, x0, y, rule.states - state);
+            }
+            if (x < INT32_MAX) x += run;
+        }
+    }
+    b->edits++;
+    return 0;
+}
+
+int parse_rle (Board* b, const char* data, size_t len, RleInfo* info, char* err, size_t errlen) {
+    Parser ps = {data, data + len, err, errlen};
+    if (parse_preamble(&ps, info)) return -1;
+    if (info->rule[0] && !rule_fixed) {
+        Rule r;
+        char rule_err [128];
+        if (parse_rule(info->rule, &r, rule_err, sizeof rule_err)) {
+            fprintf(stderr, "Warning: %s; running %s instead.\n", rule_err, rule.name);
+        }
+        else rule = r;
+    }
+    if (info->width > b->width || info->height > b->height) {
+        fprintf(stderr, "Warning: this %lldx%lld RLE pattern is bigger than the board and will be clipped.\n",
+            (long long)info->width, (long long)info->height
+        );
+    }
+    int64_t start_x, y;
+    if (info->has_pos) {
+        start_x = b->width / 2 + info->pos_x;
+        y = b->height / 2 - 1 - info->pos_y;
+    }
+    else {
+        start_x = (b->width - info->width) / 2;
+        y = (b->height + info->height) / 2 - 1;
+    }
+    return parse_runs(&ps, b, start_x, y);
+}
+
+ // Returns the whole contents of a file, mapped if possible and otherwise
+ // read in large chunks (for pipes and the like).  *mapped says which, for
+ // release_file.
+static char* slurp_file (const char* filename, size_t* len, int* mapped) {
+    int fd = 0==strcmp(filename, "-") ? 0 : open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        char* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            if (fd) close(fd);
+            *len = st.st_size;
+            *mapped = 1;
+            return data;
+        }
+    }
+    size_t cap = 1 << 20;
+    size_t n = 0;
+    char* data = malloc(cap);
+    for (;;) {
+        if (n == cap) {
+            cap *= 2;
+            data = realloc(data, cap);
+        }
+        ssize_t got = read(fd, data + n, cap - n);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            free(data);
+            if (fd) close(fd);
+            return NULL;
+        }
+        if (got == 0) break;
+        n += got;
+    }
+    if (fd) close(fd);
+    *len = n;
+    *mapped = 0;
+    return data;
+}
+
+static void release_file (char* data, size_t len, int mapped) {
+    if (mapped) munmap(data, len);
+    else free(data);
+}
+
+void read_rle (Board* b, const char* filename, RleInfo* info) {
+    size_t len;
+    int mapped;
+    char* data = slurp_file(filename, &len, &mapped);
+    if (!data) {
+        fprintf(stderr, "Can't open %s for reading: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+    char err [256];
+    RleInfo local;
+    if (parse_rle(b, data, len, info ? info : &local, err, sizeof err)) {
+        fprintf(stderr, "%s: %s\n", filename, err);
+        exit(1);
+    }
+    release_file(data, len, mapped);
+}
+
+ // Loads a pattern into a board of just its size, without wrapping, for
+ // stamping into another.  Unlike read_rle it leaves the rule alone and
+ // ignores any #CXRLE position.
+Board* read_pattern (const char* filename) {
+    size_t len;
+    int mapped;
+    char* data = slurp_file(filename, &len, &mapped);
+    if (!data) {
+        fprintf(stderr, "Can't open %s for reading: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+    char err [256];
+    Parser ps = {data, data + len, err, sizeof err};
+    RleInfo info;
+    Board* b = NULL;
+    if (!parse_preamble(&ps, &info)) {
+        if (info.width < 1 || info.height < 1 || info.width > 65536 || info.height > 65536) {
+            fail(&ps, "Can't stamp a %lldx%lld pattern.", (long long)info.width, (long long)info.height);
+        }
+        else {
+            b = board_new(info.width, info.height, 0);
+            if (parse_runs(&ps, b, 0, info.height - 1)) {
+                board_free(b);
+                b = NULL;
+            }
+        }
+    }
+    if (!b) {
+        fprintf(stderr, "%s: %s\n", filename, err);
+        exit(1);
+    }
+    release_file(data, len, mapped);
+    return b;
+}
@@ -0,0 +1,235 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Rules come in three families, all read in Golly's notation:
+ //   Life-like      B3/S23, or the older S/B form 23/3
+ //   Generations    B2/S/C3, or S/B/C as in 345/2/4
+ //   Larger than Life  R5,C0,M1,S34..58,B34..45,NM
+ // A topology suffix like :T100,100 is ignored, since -wrap decides that.
+
+Rule rule = {"B3/S23", 1, 0, 2, 0x008, 0x00c, RULE_LIFE, {[3] = 1}, {[2] = 1, [3] = 1}};
+int rule_fixed = 0;
+
+ // Life-like rules with kernels of their own, in the order of the RULE_
+ // kernel numbers.
+static const struct {
+    uint32_t birth;
+    uint32_t survive;
+} special_rules [] = {
+    {0x008, 0x00c},  // B3/S23
+    {0x048, 0x00c},  // B36/S23
+    {0x1c8, 0x1d8},  // B3678/S34678
+    {0x004, 0x000},  // B2/S
+};
+
+static int fail (char* err, size_t errlen, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(err, errlen, fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+ // Reads a string of neighbor counts like "236" into a mask.
+static int parse_counts (const char** p, const char* end, uint32_t* mask) {
+    *mask = 0;
+    while (*p < end && isdigit((unsigned char)**p)) {
+        int n = **p - '0';
+        if (n > 8) return -1;
+        *mask |= 1 << n;
+        (*p)++;
+    }
+    return 0;
+}
+
+static void mask_name (char* out, uint32_t mask) {
+    int n;
+    for (n = 0; n <= 8; n++) {
+        if (mask >> n & 1) *out++ = '0' + n;
+    }
+    *out = 0;
+}
+
+static int parse_life_like (const char* s, const char* end, Rule* r, char* err, size_t errlen) {
+    uint32_t birth = 0, survive = 0;
+    int states = 2;
+    int got_b = 0, got_s = 0, field = 0;
+    const char* p = s;
+    while (p <= end) {
+        const char* f = p;
+        const char* fend = memchr(p, '/', end - p);
+        if (!fend) fend = end;
+        char c = tolower((unsigned char)*f);
+        uint32_t mask;
+        if (c == 'b' || c == 's') {
+            f++;
+            if (parse_counts(&f, fend, &mask) || f != fend) goto bad;
+            if (c == 'b') {
+                birth = mask;
+                got_b = 1;
+            }
+            else {
+                survive = mask;
+                got_s = 1;
+            }
+        }
+        else if (c == 'c' || c == 'g' || (field == 2 && isdigit((unsigned char)c))) {
+            if (!isdigit((unsigned char)c)) f++;
+            char* num_end;
+            long n = strtol(f, &num_end, 10);
+            if (num_end != fend || n < 2 || n > 256) {
+                return fail(err, errlen, "Generations rules need 2 to 256 states");
+            }
+            states = n;
+        }
+        else if (field < 2) {
+             // The S/B form, without letters
+            if (parse_counts(&f, fend, &mask) || f != fend) goto bad;
+            if (field == 0) {
+                survive = mask;
+                got_s = 1;
+            }
+            else {
+                birth = mask;
+                got_b = 1;
+            }
+        }
+        else goto bad;
+        field++;
+        p = fend + 1;
+    }
+    if (!got_b || !got_s) goto bad;
+    if (birth & 1) return fail(err, errlen, "B0 rules aren't supported");
+    r->radius = 1;
+    r->middle = 0;
+    r->states = states;
+    r->birth_mask = birth;
+    r->survive_mask = survive;
+    int n;
+    for (n = 0; n <= 8; n++) {
+        r->birth[n] = birth >> n & 1;
+        r->survive[n] = survive >> n & 1;
+    }
+    char b_name [10], s_name [10];
+    mask_name(b_name, birth);
+    mask_name(s_name, survive);
+    if (states > 2) snprintf(r->name, sizeof r->name, "B%s/S%s/C%d", b_name, s_name, states);
+    else snprintf(r->name, sizeof r->name, "B%s/S%s", b_name, s_name);
+    return 0;
+  bad:
+    return fail(err, errlen, "Can't read rule %.*s", (int)(end - s), s);
+}
+
+static int parse_range (const char* f, const char* fend, int* lo, int* hi) {
+    char* e;
+    *lo = *hi = strtol(f, &e, 10);
+    if (e == f) return -1;
+    if (fend - e >= 2 && e[0] == '.' && e[1] == '.') {
+        f = e + 2;
+        *hi = strtol(f, &e, 10);
+        if (e == f) return -1;
+    }
+    return e == fend ? 0 : -1;
+}
+
+static int parse_ltl (const char* s, const char* end, Rule* r, char* err, size_t errlen) {
+    int radius = 0, states = 0, middle = 0;
+    int b0 = -1, b1 = -1, s0 = -1, s1 = -1;
+    const char* p = s;
+    while (p < end) {
+        const char* fend = memchr(p, ',', end - p);
+        if (!fend) fend = end;
+        char c = toupper((unsigned char)*p);
+        char* e;
+        if (c == 'R' || c == 'C' || c == 'M') {
+            long n = strtol(p + 1, &e, 10);
+            if (e != fend || e == p + 1) goto bad;
+            if (c == 'R') radius = n;
+            else if (c == 'C') states = n;
+            else middle = n;
+        }
+        else if (c == 'S' || c == 'B') {
+            if (parse_range(p + 1, fend, c == 'S' ? &s0 : &b0, c == 'S' ? &s1 : &b1)) goto bad;
+        }
+        else if (c == 'N') {
+            if (fend - p != 2 || toupper((unsigned char)p[1]) != 'M') {
+                return fail(err, errlen, "Only Moore neighborhoods (NM) are supported");
+            }
+        }
+        else goto bad;
+        p = fend < end ? fend + 1 : end;
+    }
+    if (radius < 1 || radius > RULE_MAX_RADIUS) {
+        return fail(err, errlen, "Larger than Life radius must be 1 to %d", RULE_MAX_RADIUS);
+    }
+    if (states < 2) states = 2;
+    if (states > 256) return fail(err, errlen, "Generations rules need 2 to 256 states");
+    if (b0 < 0 || s0 < 0 || b1 < b0 || s1 < s0) goto bad;
+    if (b0 == 0) return fail(err, errlen, "B0 rules aren't supported");
+    int max = (2 * radius + 1) * (2 * radius + 1);
+    int n;
+    memset(r->birth, 0, sizeof r->birth);
+    memset(r->survive, 0, sizeof r->survive);
+    for (n = 0; n <= max; n++) {
+        r->birth[n] = n >= b0 && n <= b1;
+        r->survive[n] = n >= s0 && n <= s1;
+    }
+    r->radius = radius;
+    r->middle = !!middle;
+    r->states = states;
+    r->birth_mask = r->survive_mask = 0;
+    if (radius == 1 && !middle) {
+        for (n = 0; n <= 8; n++) {
+            r->birth_mask |= r->birth[n] << n;
+            r->survive_mask |= r->survive[n] << n;
+        }
+    }
+    snprintf(r->name, sizeof r->name, "R%d,C%d,M%d,S%d..%d,B%d..%d,NM",
+        radius, states > 2 ? states : 0, !!middle, s0, s1, b0, b1
+    );
+    return 0;
+  bad:
+    return fail(err, errlen, "Can't read rule %.*s", (int)(end - s), s);
+}
+
+int parse_rule (const char* s, Rule* r, char* err, size_t errlen) {
+    while (isspace((unsigned char)*s)) s++;
+    const char* end = s + strcspn(s, ":");
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    if (end == s) return fail(err, errlen, "Empty rule");
+    memset(r, 0, sizeof *r);
+    int ret = toupper((unsigned char)*s) == 'R' && end - s > 1 && isdigit((unsigned char)s[1])
+        ? parse_ltl(s, end, r, err, errlen)
+        : parse_life_like(s, end, r, err, errlen);
+    if (ret) return ret;
+     // LtL rules of radius 1 that don't count the middle are Life-like.
+    r->kernel = RULE_GENERIC;
+    if (r->radius == 1 && !r->middle) {
+        int k;
+        for (k = 0; k < RULE_GENERIC; k++) {
+            if (special_rules[k].birth == r->birth_mask && special_rules[k].survive == r->survive_mask)
+                r->kernel = k;
+        }
+    }
+    return 0;
+}
+
+void select_rule (const char* s) {
+    char err [128];
+    if (parse_rule(s, &rule, err, sizeof err)) {
+        fprintf(stderr, "%s.\n", err);
+        exit(1);
+    }
+}
+
+ // Only the tiled engine knows about dying cells and wider neighborhoods.
+void check_rule_engine () {
+    if ((rule.states > 2 || rule.radius > 1 || rule.middle) && engine->step != board_step) {
+        fprintf(stderr, "The %s engine only runs Life-like rules, not %s.\n", engine->name, rule.name);
+        exit(1);
+    }
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // -script=FILE (or - for stdin) runs a stream of commands against the
+ // board instead of opening a window, one per line, with # starting a
+ // comment:
+ //
+ //   load FILE       An RLE pattern, into the cleared board, or a snapshot
+ //   new W H         An empty board, wrapping unless -no-wrap was given
+ //   random [SEED]   A soup of -density=, from SEED or the next seed
+ //   clear
+ //   rule RULE
+ //   set X Y 0|1
+ //   stamp X Y FILE  An RLE pattern centered on X, Y
+ //   step N
+ //   rewind N        Back through the history kept by -history=
+ //   stats           Records a line to -stats= if given, or prints one
+ //   census
+ //   period
+ //   save FILE       A snapshot
+ //   echo TEXT
+ //
+ // Nothing is drawn, so commands run back to back at the engine's speed.
+ // Errors stop the script, giving the line.
+
+const char* script_filename;
+
+typedef struct Stamp {
+    char* filename;
+    Board* pattern;
+    struct Stamp* next;
+} Stamp;
+
+Stamp* stamps;  // Patterns read for stamping, kept to stamp again
+
+static Board* stamp_pattern (const char* filename) {
+    Stamp* s;
+    for (s = stamps; s; s = s->next) {
+        if (!strcmp(s->filename, filename)) return s->pattern;
+    }
+    s = malloc(sizeof(Stamp));
+    s->filename = strdup(filename);
+    s->pattern = read_pattern(filename);
+    s->next = stamps;
+    stamps = s;
+    return s->pattern;
+}
+
+ // Starts the history and the period detection over for a board that's
+ // just been replaced.
+static void restart (Board* b) {
+    if (history_depth > 0) history_reset(b);
+    period_update(b);
+}
+
+static void edited (Board* b) {
+    history_record(b);
+    period_update(b);
+}
+
+Board* run_script (Board* b) {
+    FILE* f = 0==strcmp(script_filename, "-") ? stdin : fopen(script_filename, "r");
+    if (!f) {
+        fprintf(stderr, "Can't open %s for reading.\n", script_filename);
+        exit(1);
+    }
+    restart(b);
+    char line [4096];
+    int lineno = 0;
+    while (fgets(line, sizeof line, f)) {
+        lineno++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char cmd [32];
+        char arg [4096];
+        int n;
+        long long x, y, v;
+        if (sscanf(line, "%31s%n", cmd, &n) != 1) continue;
+        char* rest = line + n;
+        if (0==strcmp(cmd, "load") && sscanf(rest, "%4095s", arg) == 1) {
+            double t = now();
+            if (is_snapshot(arg)) {
+                char saved_rule [64];
+                board_free(b);
+                b = load_snapshot(arg, saved_rule, sizeof saved_rule);
+                if (!rule_fixed && saved_rule[0]) select_rule(saved_rule);
+            }
+            else {
+                board_clear(b);
+                read_rle(b, arg, NULL);
+                b->generation = 0;
+            }
+            check_rule_engine();
+            stats_time(STATS_IO, t);
+            restart(b);
+        }
+        else if (0==strcmp(cmd, "new") && sscanf(rest, "%lld %lld", &x, &y) == 2 && x > 0 && y > 0) {
+            board_free(b);
+            b = board_new(x, y, wrap);
+            restart(b);
+        }
+        else if (0==strcmp(cmd, "random")) {
+            if (sscanf(rest, "%lld", &v) == 1) seed = v;
+            else seed++;
+            board_randomize(b);
+            edited(b);
+        }
+        else if (0==strcmp(cmd, "clear")) {
+            board_clear(b);
+            edited(b);
+        }
+        else if (0==strcmp(cmd, "rule") && sscanf(rest, "%4095s", arg) == 1) {
+            select_rule(arg);
+            rule_fixed = 1;
+            check_rule_engine();
+        }
+        else if (0==strcmp(cmd, "set") && sscanf(rest, "%lld %lld %lld", &x, &y, &v) == 3) {
+            if (x < 0 || x >= b->width || y < 0 || y >= b->height) {
+                fprintf(stderr, "%s line %d: %lld, %lld is off the board.\n", script_filename, lineno, x, y);
+                exit(1);
+            }
+            board_set(b, x, y, v != 0);
+            edited(b);
+        }
+        else if (0==strcmp(cmd, "stamp") && sscanf(rest, "%lld %lld %4095s", &x, &y, arg) == 3) {
+            int x0, y0, x1, y1;
+            brush_stamp(b, stamp_pattern(arg), x, y);
+            if (brush_apply(b, &x0, &y0, &x1, &y1)) edited(b);
+        }
+        else if (0==strcmp(cmd, "step") && sscanf(rest, "%lld", &v) == 1 && v >= 0) {
+            double t = now();
+            if (history_depth > 0) {
+                 // Every generation is recorded, so rewind can go back to any.
+                while (v--) {
+                    engine->step(b, 1);
+                    history_record(b);
+                }
+            }
+            else if (v) engine->step(b, v);
+            stats_time(STATS_STEP, t);
+            period_update(b);
+        }
+        else if (0==strcmp(cmd, "rewind") && sscanf(rest, "%lld", &v) == 1 && v >= 0) {
+            if (history_depth <= 0) {
+                fprintf(stderr, "%s line %d: rewind needs -history=N.\n", script_filename, lineno);
+                exit(1);
+            }
+            uint64_t oldest, newest;
+            history_range(&oldest, &newest);
+            history_seek(b, b->generation - oldest > (uint64_t)v ? b->generation - v : oldest);
+            period_update(b);
+        }
+        else if (0==strcmp(cmd, "stats")) {
+            if (stats_on) stats_record(b);
+            else {
+                printf("Generation %llu: population %llu, hash %016llx\n",
+                    (unsigned long long)b->generation, (unsigned long long)engine->population(b),
+                    (unsigned long long)board_hash(b)
+                );
+            }
+        }
+        else if (0==strcmp(cmd, "census")) census_report(b);
+        else if (0==strcmp(cmd, "period")) {
+            if (!period_on) {
+                fprintf(stderr, "%s line %d: period needs -period.\n", script_filename, lineno);
+                exit(1);
+            }
+            period_report(b);
+        }
+        else if (0==strcmp(cmd, "save") && sscanf(rest, "%4095s", arg) == 1) {
+            double t = now();
+            save_snapshot(b, arg);
+            stats_time(STATS_IO, t);
+        }
+        else if (0==strcmp(cmd, "echo")) {
+            while (*rest == ' ' || *rest == '\t') rest++;
+            fputs(rest, stdout);
+            if (!strchr(rest, '\n')) putchar('\n');
+        }
+        else {
+            fprintf(stderr, "%s line %d: can't understand: %s", script_filename, lineno, line);
+            if (!strchr(line, '\n')) fputc('\n', stderr);
+            exit(1);
+        }
+        fflush(stdout);
+    }
+    if (f != stdin) fclose(f);
+    return b;
+}
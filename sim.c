@@ -0,0 +1,172 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Turbo mode runs the engine on a thread of its own, as fast as it goes,
+ // instead of one step per displayed frame.  Generations are run in batches
+ // sized to take about frame_ms each, and after each batch the cells are
+ // copied into one of three frames.  The simulation fills the back frame
+ // and swaps it with the ready one; the display swaps the ready one with
+ // its front frame whenever it's newer.  Neither ever waits for the other,
+ // so a slow present doesn't hold up the simulation and a huge batch
+ // doesn't hold up the present.  The ready slot is packed into one word
+ // (index | SIM_FRESH) so each swap is a single atomic exchange.
+#define SIM_FRESH 4
+
+double sim_gens_per_sec;
+
+typedef struct Frame {
+    uint64_t generation;
+    uint64_t* cells;
+} Frame;
+
+Board* sim_board;
+Frame frames [3];
+int back_slot;
+int front_slot;
+_Atomic int ready_slot;
+pthread_t sim_tid;
+pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t sim_cond = PTHREAD_COND_INITIALIZER;
+int sim_running;
+int sim_paused;
+_Atomic int edits_waiting;
+
+static size_t frame_words () {
+    return (size_t)sim_board->words * sim_board->height;
+}
+
+ // Copies the board into the back frame and makes it the ready one.  Only
+ // called with sim_mutex held, so from either thread.
+static void publish () {
+    Frame* f = &frames[back_slot];
+    memcpy(f->cells, sim_board->cells, frame_words() * sizeof(uint64_t));
+    f->generation = sim_board->generation;
+    back_slot = atomic_exchange(&ready_slot, back_slot | SIM_FRESH) & 3;
+}
+
+static void* sim_thread (void* arg) {
+    (void)arg;
+    uint64_t batch = 1;
+    double rate_start = now();
+    uint64_t rate_gens = 0;
+    pthread_mutex_lock(&sim_mutex);
+    while (sim_running) {
+        if (sim_paused) {
+            pthread_cond_wait(&sim_cond, &sim_mutex);
+            rate_start = now();
+            rate_gens = 0;
+            continue;
+        }
+        double start = now();
+        uint64_t done = 0;
+         // The history keeps every generation and stats sample every
+         // stats_every of them, so a batch stops for each of those.
+        while (done < batch) {
+            uint64_t n = history_depth > 0 ? 1 : batch - done;
+            uint64_t to_sample = stats_every - sim_board->generation % stats_every;
+            if (stats_on && n > to_sample) n = to_sample;
+            double t = now();
+            engine->step(sim_board, n);
+            stats_time(STATS_STEP, t);
+            done += n;
+            history_record(sim_board);
+            if (sim_board->generation % stats_every == 0) stats_record(sim_board);
+        }
+        publish();
+        double secs = now() - start;
+        rate_gens += batch;
+         // Aim the next batch at the frame budget, but don't let one
+         // slow or fast batch swing it by more than a factor of 4.
+        double scale = secs > 0 ? frame_ms / 1000 / secs : 4;
+        if (scale > 4) scale = 4;
+        if (scale < 0.25) scale = 0.25;
+        batch = batch * scale;
+        if (batch < 1) batch = 1;
+        if (start - rate_start >= 1) {
+            sim_gens_per_sec = rate_gens / (now() - rate_start);
+            rate_start = now();
+            rate_gens = 0;
+        }
+         // Give edits waiting on the lock a turn between batches, since
+         // the mutex alone would usually go straight back to this thread.
+        pthread_mutex_unlock(&sim_mutex);
+        while (atomic_load(&edits_waiting)) sched_yield();
+        pthread_mutex_lock(&sim_mutex);
+    }
+    pthread_mutex_unlock(&sim_mutex);
+    return NULL;
+}
+
+ // Starts stepping b on the simulation thread.  From here until sim_stop,
+ // b may only be touched between sim_lock and sim_unlock.
+void sim_start (Board* b, int paused) {
+    int i;
+    sim_board = b;
+    for (i = 0; i < 3; i++) {
+        frames[i].cells = alloc_words(frame_words());
+    }
+    back_slot = 0;
+    front_slot = 1;
+    atomic_store(&ready_slot, 2);
+    sim_running = 1;
+    sim_paused = paused;
+    sim_gens_per_sec = 0;
+    pthread_mutex_lock(&sim_mutex);
+    publish();
+    pthread_mutex_unlock(&sim_mutex);
+    if (pthread_create(&sim_tid, NULL, sim_thread, NULL)) {
+        fprintf(stderr, "Failed to create the simulation thread.\n");
+        exit(1);
+    }
+}
+
+void sim_stop () {
+    int i;
+    sim_lock();
+    sim_running = 0;
+    pthread_cond_signal(&sim_cond);
+    pthread_mutex_unlock(&sim_mutex);
+    pthread_join(sim_tid, NULL);
+    for (i = 0; i < 3; i++) {
+        free(frames[i].cells);
+        frames[i].cells = NULL;
+    }
+    sim_board = NULL;
+}
+
+void sim_pause (int paused) {
+    sim_lock();
+    sim_paused = paused;
+    pthread_cond_signal(&sim_cond);
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+ // Waits for the current batch to finish and takes the board.
+void sim_lock () {
+    atomic_fetch_add(&edits_waiting, 1);
+    pthread_mutex_lock(&sim_mutex);
+    atomic_fetch_sub(&edits_waiting, 1);
+}
+ // Gives the board back, publishing whatever was done to it.
+void sim_unlock () {
+    publish();
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+ // Points *cells at the newest frame, which stays valid until the next
+ // call.  Returns 1 if it's newer than what the last call returned.
+int sim_frame (const uint64_t** cells, uint64_t* generation) {
+    int fresh = 0;
+    if (atomic_load(&ready_slot) & SIM_FRESH) {
+        front_slot = atomic_exchange(&ready_slot, front_slot) & 3;
+        fresh = 1;
+    }
+    *cells = frames[front_slot].cells;
+    *generation = frames[front_slot].generation;
+    return fresh;
+}
@@ -0,0 +1,362 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "golsh.h"
+
+ // A snapshot file is a series of frames.  The first frame holds every
+ // chunk (band of SNAP_CHUNK_ROWS rows) of the board, and each later frame
+ // holds only the chunks that changed since the one before it, so loading
+ // means applying each frame in turn.  Every frame ends with a checksum, and
+ // a frame that's torn or corrupt ends the file there, so a crash in the
+ // middle of a checkpoint only loses that checkpoint.
+ //
+ // Under a Generations rule the age planes follow the cells as more chunks,
+ // plane p's band i being chunk (p + 1) * bands + i, and the header's flags
+ // say how many planes there are.
+ //
+ // Everything is a multiple of 8 bytes so chunk data in a mapped file is
+ // word-aligned and can be copied or decoded straight into the board.
+#define SNAP_MAGIC "GOLSNAP1"
+#define SNAP_END "GOLSEND1"
+#define SNAP_VERSION 1
+#define SNAP_CHUNK_ROWS 64
+#define SNAP_FULL 1
+#define SNAP_PLANES_SHIFT 8  // The age planes are flags >> SNAP_PLANES_SHIFT
+
+enum {
+    CHUNK_RAW,
+    CHUNK_ZERO_RUNS,  // Words of zeros (low half) << 0 | literals (high half) << 32, then the literals
+};
+
+typedef struct SnapHeader {
+    char magic [8];
+    uint32_t version;
+    uint32_t flags;
+    int32_t width;
+    int32_t height;
+    int32_t wrap;
+    int32_t chunk_rows;
+    uint64_t generation;
+    uint64_t chunks;  // Chunks in this frame
+    char rule [64];
+} SnapHeader;
+
+typedef struct SnapChunk {
+    uint32_t index;
+    uint32_t encoding;
+    uint64_t words;
+} SnapChunk;
+
+typedef struct SnapTrailer {
+    char magic [8];
+    uint64_t bytes;  // Of the whole frame, including this
+    uint64_t check;
+} SnapTrailer;
+
+static uint64_t hash_words (uint64_t h, const uint64_t* p, size_t n) {
+    size_t i;
+    for (i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 0x9e3779b97f4a7c15;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static int band_count (const Board* b) {
+    return (b->height + SNAP_CHUNK_ROWS - 1) / SNAP_CHUNK_ROWS;
+}
+
+ // Bands of cells, then of each age plane.
+static int chunk_count (const Board* b) {
+    return band_count(b) * (1 + b->age_planes);
+}
+
+static size_t chunk_words (const Board* b, int i) {
+    int y0 = i % band_count(b) * SNAP_CHUNK_ROWS;
+    int y1 = y0 + SNAP_CHUNK_ROWS < b->height ? y0 + SNAP_CHUNK_ROWS : b->height;
+    return (size_t)(y1 - y0) * b->words;
+}
+
+static uint64_t* chunk_at (const Board* b, int i) {
+    int n = band_count(b);
+    size_t row = (size_t)(i % n) * SNAP_CHUNK_ROWS;
+    if (i < n) return &b->cells[row * b->words];
+    return &b->ages[((size_t)(i / n - 1) * b->height + row) * b->words];
+}
+
+ // Encodes n words as runs of zeros and literals into out, which has room
+ // for n words.  Returns the number of words used, or 0 if that wouldn't
+ // be any smaller than the raw words.
+static size_t encode_zero_runs (const uint64_t* p, size_t n, uint64_t* out) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        size_t zeros = 0, lits = 0;
+        while (i + zeros < n && !p[i + zeros] && zeros < UINT32_MAX) zeros++;
+        i += zeros;
+         // Literals run until two zeros in a row, where a new token pays off.
+        while (i + lits < n && lits < UINT32_MAX
+         && (p[i + lits] || (i + lits + 1 < n && p[i + lits + 1]))) lits++;
+        if (o + 1 + lits >= n) return 0;
+        out[o++] = (uint64_t)lits << 32 | zeros;
+        memcpy(&out[o], &p[i], lits * sizeof(uint64_t));
+        o += lits;
+        i += lits;
+    }
+    return o;
+}
+
+static int decode_zero_runs (const uint64_t* in, size_t len, uint64_t* p, size_t n) {
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint64_t zeros = in[i] & 0xffffffff;
+        uint64_t lits = in[i] >> 32;
+        i++;
+        if (zeros + lits > n - o || lits > len - i) return -1;
+        memset(&p[o], 0, zeros * sizeof(uint64_t));
+        o += zeros;
+        memcpy(&p[o], &in[i], lits * sizeof(uint64_t));
+        o += lits;
+        i += lits;
+    }
+    if (o != n) return -1;
+    return 0;
+}
+
+typedef struct Writer {
+    FILE* f;
+    uint64_t bytes;
+    uint64_t check;
+} Writer;
+
+static void put (Writer* w, const void* data, size_t bytes) {
+    w->check = hash_words(w->check, data, bytes / sizeof(uint64_t));
+    w->bytes += bytes;
+    fwrite(data, 1, bytes, w->f);
+}
+
+ // Appends a frame holding the chunks flagged in which (all of them if
+ // which is NULL) to f, and returns its size in bytes.
+static uint64_t write_frame (FILE* f, Board* b, const unsigned char* which) {
+    int n = chunk_count(b);
+    int i;
+    SnapHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, SNAP_MAGIC, 8);
+    h.version = SNAP_VERSION;
+    h.flags = (which ? 0 : SNAP_FULL) | b->age_planes << SNAP_PLANES_SHIFT;
+    h.width = b->width;
+    h.height = b->height;
+    h.wrap = b->wrap;
+    h.chunk_rows = SNAP_CHUNK_ROWS;
+    h.generation = b->generation;
+    for (i = 0; i < n; i++) h.chunks += !which || which[i];
+    snprintf(h.rule, sizeof h.rule, "%s", rule.name);
+    Writer w = {f, 0, 0};
+    put(&w, &h, sizeof h);
+    uint64_t* buf = alloc_words((size_t)SNAP_CHUNK_ROWS * b->words);
+    for (i = 0; i < n; i++) {
+        if (which && !which[i]) continue;
+        size_t words = chunk_words(b, i);
+        size_t enc = encode_zero_runs(chunk_at(b, i), words, buf);
+        SnapChunk c = {i, enc ? CHUNK_ZERO_RUNS : CHUNK_RAW, enc ? enc : words};
+        put(&w, &c, sizeof c);
+        put(&w, enc ? buf : chunk_at(b, i), c.words * sizeof(uint64_t));
+    }
+    free(buf);
+    SnapTrailer t;
+    memcpy(t.magic, SNAP_END, 8);
+    t.bytes = w.bytes + sizeof t;
+    t.check = w.check;
+    fwrite(&t, 1, sizeof t, f);
+    return t.bytes;
+}
+
+static void write_failed (const char* filename) {
+    fprintf(stderr, "Failed to write %s: %s\n", filename, strerror(errno));
+    exit(1);
+}
+
+ // Writes a complete snapshot next to filename and renames it into place,
+ // so that filename always holds either the old snapshot or the new one.
+static uint64_t write_full (Board* b, const char* filename) {
+    size_t len = strlen(filename);
+    char* tmp = malloc(len + 5);
+    memcpy(tmp, filename, len);
+    memcpy(tmp + len, ".tmp", 5);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) write_failed(tmp);
+    uint64_t bytes = write_frame(f, b, NULL);
+    if (fflush(f) || fsync(fileno(f)) || fclose(f)) write_failed(tmp);
+    if (rename(tmp, filename)) write_failed(filename);
+    free(tmp);
+    return bytes;
+}
+
+void save_snapshot (Board* b, const char* filename) {
+    write_full(b, filename);
+}
+
+ // What the last checkpoint wrote, to tell which chunks have changed since.
+const char* ckpt_filename;
+Board* ckpt_board;
+uint64_t* ckpt_hashes;
+int ckpt_planes;
+uint64_t ckpt_full_bytes;
+uint64_t ckpt_file_bytes;
+
+void checkpoint (Board* b, const char* filename) {
+    int n = chunk_count(b);
+    int i;
+    int full = b != ckpt_board || filename != ckpt_filename || b->age_planes != ckpt_planes
+            || ckpt_file_bytes >= 2 * ckpt_full_bytes;
+    if (b != ckpt_board || b->age_planes != ckpt_planes) {
+        free(ckpt_hashes);
+        ckpt_hashes = calloc(n, sizeof(uint64_t));
+    }
+    unsigned char* which = malloc(n);
+    for (i = 0; i < n; i++) {
+        uint64_t h = hash_words(1, chunk_at(b, i), chunk_words(b, i));
+        which[i] = full || h != ckpt_hashes[i];
+        ckpt_hashes[i] = h;
+    }
+    if (full) {
+         // Start over with a complete snapshot once the deltas have grown as
+         // big as it, so loading never has to replay too much.
+        ckpt_full_bytes = ckpt_file_bytes = write_full(b, filename);
+    }
+    else {
+         // Even with no chunks changed, a frame records the generation.
+        FILE* f = fopen(filename, "ab");
+        if (!f) write_failed(filename);
+        ckpt_file_bytes += write_frame(f, b, which);
+        if (fflush(f) || fdatasync(fileno(f)) || fclose(f)) write_failed(filename);
+    }
+    free(which);
+    ckpt_board = b;
+    ckpt_filename = filename;
+    ckpt_planes = b->age_planes;
+}
+
+int is_snapshot (const char* filename) {
+    char magic [8];
+    FILE* f = fopen(filename, "rb");
+    if (!f) return 0;
+    int yes = fread(magic, 1, 8, f) == 8 && 0==memcmp(magic, SNAP_MAGIC, 8);
+    fclose(f);
+    return yes;
+}
+
+ // Checks the frame at data and returns its size, or 0 if it's torn,
+ // corrupt or doesn't fit a board like b.
+static uint64_t check_frame (const char* data, uint64_t len, const SnapHeader* first) {
+    const SnapHeader* h = (const SnapHeader*)data;
+    if (len < sizeof *h + sizeof(SnapTrailer) || memcmp(h->magic, SNAP_MAGIC, 8)
+     || h->version != SNAP_VERSION || h->width != first->width || h->height != first->height
+     || h->chunk_rows != SNAP_CHUNK_ROWS
+     || h->flags >> SNAP_PLANES_SHIFT != first->flags >> SNAP_PLANES_SHIFT) return 0;
+    uint64_t off = sizeof *h;
+    uint64_t i;
+    for (i = 0; i < h->chunks; i++) {
+        if (len - off < sizeof(SnapChunk) + sizeof(SnapTrailer)) return 0;
+        const SnapChunk* c = (const SnapChunk*)(data + off);
+        off += sizeof *c;
+        if (c->words > (len - off - sizeof(SnapTrailer)) / sizeof(uint64_t)) return 0;
+        off += c->words * sizeof(uint64_t);
+    }
+    const SnapTrailer* t = (const SnapTrailer*)(data + off);
+    if (len - off < sizeof *t || memcmp(t->magic, SNAP_END, 8) || t->bytes != off + sizeof *t)
+        return 0;
+    if (hash_words(0, (const uint64_t*)data, off / sizeof(uint64_t)) != t->check) return 0;
+    return t->bytes;
+}
+
+static int apply_frame (Board* b, const char* data) {
+    const SnapHeader* h = (const SnapHeader*)data;
+    const char* p = data + sizeof *h;
+    int n = chunk_count(b);
+    uint64_t i;
+    for (i = 0; i < h->chunks; i++) {
+        const SnapChunk* c = (const SnapChunk*)p;
+        const uint64_t* words = (const uint64_t*)(p + sizeof *c);
+        p += sizeof *c + c->words * sizeof(uint64_t);
+        if (c->index >= n) return -1;
+        size_t want = chunk_words(b, c->index);
+        if (c->encoding == CHUNK_RAW) {
+            if (c->words != want) return -1;
+            memcpy(chunk_at(b, c->index), words, want * sizeof(uint64_t));
+        }
+        else if (c->encoding == CHUNK_ZERO_RUNS) {
+            if (decode_zero_runs(words, c->words, chunk_at(b, c->index), want)) return -1;
+        }
+        else return -1;
+    }
+    b->generation = h->generation;
+    return 0;
+}
+
+ // Makes a board from a snapshot, applying checkpoint frames up to the last
+ // intact one.  The rule of the last frame applied, which a checkpoint
+ // after a rule change differs from the first in, goes in rule_name if
+ // that isn't NULL.
+Board* load_snapshot (const char* filename, char* rule_name, size_t rulelen) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        fprintf(stderr, "Can't open %s for reading: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+    uint64_t len = st.st_size;
+    char* data = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Can't map %s: %s\n", filename, strerror(errno));
+        exit(1);
+    }
+    madvise(data, len, MADV_SEQUENTIAL);
+    const SnapHeader* first = (const SnapHeader*)data;
+    uint64_t size = check_frame(data, len, first);
+    if (!size || !(first->flags & SNAP_FULL) || first->width <= 0 || first->height <= 0) {
+        fprintf(stderr, "%s is not a valid snapshot.\n", filename);
+        exit(1);
+    }
+    Board* b = board_new(first->width, first->height, first->wrap);
+    int planes = first->flags >> SNAP_PLANES_SHIFT;
+    if (planes > 8) {
+        fprintf(stderr, "%s is not a valid snapshot.\n", filename);
+        exit(1);
+    }
+    if (planes) {
+        b->age_planes = planes;
+        b->ages = alloc_words((size_t)planes * b->words * b->height);
+    }
+    uint64_t off = 0;
+    while (off < len) {
+        size = check_frame(data + off, len - off, first);
+        if (!size) {
+            fprintf(stderr, "Warning: ignoring a torn checkpoint at the end of %s.\n", filename);
+            break;
+        }
+        if (apply_frame(b, data + off)) {
+            fprintf(stderr, "%s has a malformed chunk.\n", filename);
+            exit(1);
+        }
+        const SnapHeader* h = (const SnapHeader*)(data + off);
+        if (rule_name) snprintf(rule_name, rulelen, "%.*s", (int)sizeof h->rule, h->rule);
+        off += size;
+    }
+    munmap(data, len);
+     // Don't trust the file to have kept the bits past the edge clear.
+    int y;
+    for (y = 0; y < b->height * (1 + planes); y++) {
+        uint64_t* row = y < b->height ? &b->cells[(size_t)y * b->words]
+                                      : &b->ages[(size_t)(y - b->height) * b->words];
+        row[b->words - 1] &= b->tail;
+    }
+    b->edits++;
+    return b;
+}
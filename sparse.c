@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "golsh.h"
+
+ // Only tiles whose neighborhood has changed get recomputed.  A tile is
+ // marked active when a step writes something different from what was
+ // already in that buffer, which is the generation before last.  If a tile
+ // and its neighbors are all inactive, their current generation is the same
+ // as the one before last, so the next generation is the same as the last
+ // one, which is already sitting in the buffer we'd write to.  This skips
+ // both still lifes and period-2 oscillators without ever copying.
+#define SPARSE_TILE_WORDS 8
+#define SPARSE_TILE_ROWS 32
+
+int tiles_w;
+int tiles_h;
+unsigned char* active;
+unsigned char* was_active;
+Board* sparse_board;
+uint64_t sparse_edits = -1;
+uint64_t sparse_generation;
+int trust_buffers;
+uint64_t tiles_stepped;
+uint64_t tiles_total;
+
+static void sparse_reset (Board* b) {
+    tiles_w = (b->words + SPARSE_TILE_WORDS - 1) / SPARSE_TILE_WORDS;
+    tiles_h = (b->height + SPARSE_TILE_ROWS - 1) / SPARSE_TILE_ROWS;
+    free(active);
+    free(was_active);
+    active = malloc(tiles_w * tiles_h);
+    was_active = malloc(tiles_w * tiles_h);
+    memset(active, 1, tiles_w * tiles_h);
+     // The other buffer holds nothing useful yet, so the first step can't
+     // tell what really changed.
+    trust_buffers = 0;
+    sparse_board = b;
+}
+
+static int neighborhood_active (Board* b, int tx, int ty) {
+    int dx, dy;
+    for (dy = -1; dy <= 1; dy++) {
+        int y = ty + dy;
+        if (y < 0 || y >= tiles_h) {
+            if (!b->wrap) continue;
+            y = (y + tiles_h) % tiles_h;
+        }
+        for (dx = -1; dx <= 1; dx++) {
+            int x = tx + dx;
+            if (x < 0 || x >= tiles_w) {
+                if (!b->wrap) continue;
+                x = (x + tiles_w) % tiles_w;
+            }
+            if (was_active[y * tiles_w + x]) return 1;
+        }
+    }
+    return 0;
+}
+
+void sparse_step (Board* b, uint64_t gens) {
+    if (b != sparse_board || b->edits != sparse_edits || b->generation != sparse_generation)
+        sparse_reset(b);
+    uint64_t* old = alloc_words((size_t)b->words * SPARSE_TILE_ROWS);
+    unsigned char* need = malloc(tiles_w);
+    while (gens--) {
+        int tx, ty;
+        unsigned char* tmp = was_active;
+        was_active = active;
+        active = tmp;
+        for (ty = 0; ty < tiles_h; ty++) {
+            int y0 = ty * SPARSE_TILE_ROWS;
+            int y1 = y0 + SPARSE_TILE_ROWS < b->height ? y0 + SPARSE_TILE_ROWS : b->height;
+            int y;
+            for (tx = 0; tx < tiles_w; tx++) {
+                need[tx] = neighborhood_active(b, tx, ty);
+                tiles_total++;
+                tiles_stepped += need[tx];
+            }
+             // Step runs of adjacent tiles together so the kernel gets spans
+             // long enough to vectorize.
+            for (tx = 0; tx < tiles_w; ) {
+                if (!need[tx]) {
+                    active[ty * tiles_w + tx++] = 0;
+                    continue;
+                }
+                int tx1 = tx;
+                while (tx1 < tiles_w && need[tx1]) tx1++;
+                int j0 = tx * SPARSE_TILE_WORDS;
+                int j1 = tx1 * SPARSE_TILE_WORDS < b->words ? tx1 * SPARSE_TILE_WORDS : b->words;
+                for (y = y0; y < y1; y++) {
+                    memcpy(&old[(size_t)(y - y0) * b->words + j0],
+                        &b->next[(size_t)y * b->words + j0], (j1 - j0) * sizeof(uint64_t)
+                    );
+                }
+                step_tile(b, y0, y1, j0, j1);
+                for (; tx < tx1; tx++) {
+                    int k0 = tx * SPARSE_TILE_WORDS;
+                    int k1 = k0 + SPARSE_TILE_WORDS < b->words ? k0 + SPARSE_TILE_WORDS : b->words;
+                    int changed = !trust_buffers;
+                    for (y = y0; y < y1 && !changed; y++) {
+                        changed = memcmp(&old[(size_t)(y - y0) * b->words + k0],
+                            &b->next[(size_t)y * b->words + k0], (k1 - k0) * sizeof(uint64_t)
+                        );
+                    }
+                    active[ty * tiles_w + tx] = !!changed;
+                }
+            }
+        }
+        trust_buffers = 1;
+        board_swap(b);
+    }
+    free(old);
+    free(need);
+    sparse_edits = b->edits;
+    sparse_generation = b->generation;
+}
+
+ // The fraction of tiles that changed in the last generation stepped.
+double sparse_active_fraction () {
+    int i, n = tiles_w * tiles_h, count = 0;
+    for (i = 0; i < n; i++) count += active[i];
+    return n ? (double)count / n : 0;
+}
+
+void sparse_report (Board* b) {
+    printf("Active tiles: %.2f%% of %d (%.2f%% stepped overall)\n",
+        sparse_active_fraction() * 100, tiles_w * tiles_h,
+        tiles_total ? 100.0 * tiles_stepped / tiles_total : 0
+    );
+}
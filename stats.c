@@ -0,0 +1,256 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "golsh.h"
+
+ // Counters for each generation are gathered by step_tile as it finishes a
+ // tile, while the rows it just wrote are still in L1, and added into the
+ // board's stats_next with atomics so tiles on any thread can report.
+ // board_swap turns them into the stats of the generation it makes.  They
+ // go to -stats=FILE every -stats-every=N generations as CSV if the name
+ // ends in .csv and JSON lines otherwise, and to -stats-shm=NAME, a POSIX
+ // shared memory block that monitors can read without stopping anything.
+int stats_on;
+const char* stats_filename;
+long long stats_every = 1;
+const char* stats_shm_name;
+uint64_t stats_ns [STATS_TIMERS];
+
+FILE* stats_file;
+int stats_csv;
+SharedStats* shared;
+
+void stats_clear (StepStats* s) {
+    memset(s, 0, sizeof *s);
+    s->xmin = s->ymin = INT64_MAX;
+    s->xmax = s->ymax = INT64_MIN;
+}
+
+static void atomic_min (int64_t* p, int64_t v) {
+    int64_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v < old && !__atomic_compare_exchange_n(p, &old, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+static void atomic_max (int64_t* p, int64_t v) {
+    int64_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v > old && !__atomic_compare_exchange_n(p, &old, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+ // Counts the rows y0 to y1 of next, and what changed from cells, into t.
+ // The row sums are kept free of branches so they vectorize, and compiled
+ // once per instruction set so that machines with popcount instructions,
+ // scalar or vector, use them instead of the bit twiddling plain -O2 gets.
+#define COUNT_ROWS(name, attr) \
+attr static void name ( \
+    const uint64_t* cells, const uint64_t* next, int words, \
+    int y0, int y1, int j0, int j1, StepStats* t \
+) { \
+    int y, j; \
+    for (y = y0; y < y1; y++) { \
+        const uint64_t* in = &cells[(size_t)y * words]; \
+        const uint64_t* out = &next[(size_t)y * words]; \
+        uint64_t pop = 0, births = 0, deaths = 0, any = 0; \
+        for (j = j0; j < j1; j++) { \
+            uint64_t n = out[j], o = in[j]; \
+            pop += __builtin_popcountll(n); \
+            births += __builtin_popcountll(n & ~o); \
+            deaths += __builtin_popcountll(o & ~n); \
+            any |= n; \
+        } \
+        t->population += pop; \
+        t->births += births; \
+        t->deaths += deaths; \
+        if (!any) continue; \
+        int first = j0, last = j1 - 1; \
+        while (!out[first]) first++; \
+        while (!out[last]) last--; \
+        if (t->ymin > y) t->ymin = y; \
+        t->ymax = y; \
+        int64_t x0 = (int64_t)first * 64 + __builtin_ctzll(out[first]); \
+        int64_t x1 = (int64_t)last * 64 + 63 - __builtin_clzll(out[last]); \
+        if (t->xmin > x0) t->xmin = x0; \
+        if (t->xmax < x1) t->xmax = x1; \
+    } \
+}
+COUNT_ROWS(count_rows_avx512, __attribute__((target("avx512f,avx512vpopcntdq"), optimize("tree-vectorize"))))
+COUNT_ROWS(count_rows_popcnt, __attribute__((target("popcnt"))))
+COUNT_ROWS(count_rows_plain, )
+
+static void count_rows (
+    const uint64_t* cells, const uint64_t* next, int words,
+    int y0, int y1, int j0, int j1, StepStats* t
+) {
+    static int level = -1;
+    if (level < 0) {
+        level = __builtin_cpu_supports("avx512vpopcntdq") ? 2 : __builtin_cpu_supports("popcnt");
+    }
+    if (level == 2) count_rows_avx512(cells, next, words, y0, y1, j0, j1, t);
+    else if (level == 1) count_rows_popcnt(cells, next, words, y0, y1, j0, j1, t);
+    else count_rows_plain(cells, next, words, y0, y1, j0, j1, t);
+}
+
+void tile_stats (Board* b, int y0, int y1, int j0, int j1) {
+    StepStats t;
+    stats_clear(&t);
+    count_rows(b->cells, b->next, b->words, y0, y1, j0, j1, &t);
+    StepStats* s = &b->stats_next;
+    __atomic_fetch_add(&s->population, t.population, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->births, t.births, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->deaths, t.deaths, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->tiles, 1, __ATOMIC_RELAXED);
+    if (t.population) {
+        atomic_min(&s->xmin, t.xmin);
+        atomic_min(&s->ymin, t.ymin);
+        atomic_max(&s->xmax, t.xmax);
+        atomic_max(&s->ymax, t.ymax);
+    }
+}
+
+ // Called by board_swap once every tile of the generation is in.
+void stats_latch (Board* b) {
+    b->stats = b->stats_next;
+    b->stats.generation = b->generation;
+    b->stats.edits = b->edits;
+    b->stats.counted = 1;
+    stats_clear(&b->stats_next);
+}
+
+ // Engines other than tiled skip tiles or step elsewhere, so their
+ // counters would be partial; the board is scanned for what can be seen
+ // after the fact, and births and deaths are left unknown.  Tiles stepped
+ // are still right for the sparse engine, which goes through step_tile.
+static void scan_board (Board* b, StepStats* s) {
+    uint64_t tiles = b->stats.generation == b->generation ? b->stats.tiles : 0;
+    stats_clear(s);
+    count_rows(b->cells, b->cells, b->words, 0, b->height, 0, b->words, s);
+    s->tiles = tiles;
+    s->generation = b->generation;
+}
+
+void stats_open () {
+    if (stats_filename) {
+        stats_file = 0==strcmp(stats_filename, "-") ? stdout : fopen(stats_filename, "w");
+        if (!stats_file) {
+            fprintf(stderr, "Could not open %s for writing.\n", stats_filename);
+            exit(1);
+        }
+        size_t len = strlen(stats_filename);
+        stats_csv = len >= 4 && 0==strcmp(stats_filename + len - 4, ".csv");
+        if (stats_csv) {
+            fprintf(stats_file, "generation,population,births,deaths,xmin,ymin,xmax,ymax,tiles,step_ns,render_ns,io_ns\n");
+        }
+    }
+    if (stats_shm_name) {
+        int fd = shm_open(stats_shm_name, O_RDWR | O_CREAT, 0644);
+        if (fd < 0 || ftruncate(fd, sizeof(SharedStats))) {
+            fprintf(stderr, "Could not create shared memory %s.\n", stats_shm_name);
+            exit(1);
+        }
+        shared = mmap(NULL, sizeof(SharedStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (shared == MAP_FAILED) {
+            fprintf(stderr, "Could not map shared memory %s.\n", stats_shm_name);
+            exit(1);
+        }
+        memset(shared, 0, sizeof *shared);
+        shared->size = sizeof *shared;
+        shared->version = STATS_VERSION;
+        __atomic_store_n(&shared->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+    }
+    stats_on = stats_file || shared;
+    if (stats_every < 1) stats_every = 1;
+}
+
+void stats_close () {
+    if (stats_file && stats_file != stdout) fclose(stats_file);
+    else if (stats_file) fflush(stats_file);
+    stats_file = NULL;
+    if (shared) munmap(shared, sizeof *shared);
+    shared = NULL;
+    stats_on = 0;
+}
+
+void stats_time (int which, double start) {
+    __atomic_fetch_add(&stats_ns[which], (uint64_t)((now() - start) * 1e9), __ATOMIC_RELAXED);
+}
+
+ // Writes out the stats of the board's current generation.
+void stats_record (Board* b) {
+    if (!stats_on) return;
+    double start = now();
+    StepStats s;
+    if (engine->step == board_step && b->stats.counted
+        && b->stats.generation == b->generation && b->stats.edits == b->edits
+    ) {
+        s = b->stats;
+    }
+    else scan_board(b, &s);
+    int any = s.population > 0;
+    uint64_t ns [STATS_TIMERS];
+    int i;
+    for (i = 0; i < STATS_TIMERS; i++) ns[i] = __atomic_load_n(&stats_ns[i], __ATOMIC_RELAXED);
+    if (shared) {
+         // A seqlock: readers retry while seq is odd or changed under them.
+        uint64_t seq = shared->seq;
+        __atomic_store_n(&shared->seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        shared->generation = s.generation;
+        shared->population = s.population;
+        shared->births = s.births;
+        shared->deaths = s.deaths;
+        shared->counted = s.counted;
+        shared->xmin = any ? s.xmin : 0;
+        shared->ymin = any ? s.ymin : 0;
+        shared->xmax = any ? s.xmax : -1;
+        shared->ymax = any ? s.ymax : -1;
+        shared->tiles = s.tiles;
+        shared->step_ns = ns[STATS_STEP];
+        shared->render_ns = ns[STATS_RENDER];
+        shared->io_ns = ns[STATS_IO];
+        __atomic_store_n(&shared->seq, seq + 2, __ATOMIC_RELEASE);
+    }
+    if (stats_file) {
+        char births [24] = "", deaths [24] = "";
+        char box [96] = "";
+        if (s.counted) {
+            snprintf(births, sizeof births, "%llu", (unsigned long long)s.births);
+            snprintf(deaths, sizeof deaths, "%llu", (unsigned long long)s.deaths);
+        }
+        if (stats_csv) {
+            if (any) {
+                snprintf(box, sizeof box, "%lld,%lld,%lld,%lld",
+                    (long long)s.xmin, (long long)s.ymin, (long long)s.xmax, (long long)s.ymax
+                );
+            }
+            else strcpy(box, ",,,");
+            fprintf(stats_file, "%llu,%llu,%s,%s,%s,%llu,%llu,%llu,%llu\n",
+                (unsigned long long)s.generation, (unsigned long long)s.population,
+                births, deaths, box, (unsigned long long)s.tiles,
+                (unsigned long long)ns[STATS_STEP], (unsigned long long)ns[STATS_RENDER],
+                (unsigned long long)ns[STATS_IO]
+            );
+        }
+        else {
+            if (any) {
+                snprintf(box, sizeof box, "[%lld,%lld,%lld,%lld]",
+                    (long long)s.xmin, (long long)s.ymin, (long long)s.xmax, (long long)s.ymax
+                );
+            }
+            else strcpy(box, "null");
+            fprintf(stats_file,
+                "{\"generation\":%llu,\"population\":%llu,\"births\":%s,\"deaths\":%s,"
+                "\"bbox\":%s,\"tiles\":%llu,\"step_ns\":%llu,\"render_ns\":%llu,\"io_ns\":%llu}\n",
+                (unsigned long long)s.generation, (unsigned long long)s.population,
+                s.counted ? births : "null", s.counted ? deaths : "null",
+                box, (unsigned long long)s.tiles,
+                (unsigned long long)ns[STATS_STEP], (unsigned long long)ns[STATS_RENDER],
+                (unsigned long long)ns[STATS_IO]
+            );
+        }
+         // Flushed each time so that a monitor tailing the file keeps up.
+        fflush(stats_file);
+    }
+    stats_time(STATS_IO, start);
+}
@@ -0,0 +1,445 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "golsh.h"
+
+ // -procs=N splits a headless run across N worker processes, each owning
+ // a stripe of whole rows of the board, so that the largest boards can use
+ // the memory bandwidth of every socket on the host.  A worker keeps its
+ // stripe as a board of its own with halo rows above and below, and every
+ // generation sends its top and bottom rows to the stripes either side and
+ // takes their edge rows into its halos before stepping.  Under the blocked
+ // engine the halos are -block-gens=K rows deep and exchanged every K
+ // generations, keeping its passes of K generations.  Workers pin
+ // themselves to a NUMA node, spread evenly, before allocating their
+ // stripe, so its pages are placed on that node when first touched.
+ //
+ // Rows go through links that only ever carry the rows of one stripe's
+ // edge to one neighbor, generation by generation.  -halo=shm (the default)
+ // makes each a lock-free ring of HALO_SLOTS rows in shared memory, with
+ // one process writing and the other reading; -halo=socket sends the same
+ // rows, each after its generation and length, over a socket, which stands
+ // in for the network between hosts.
+#define HALO_SLOTS 4
+
+int procs = 1;
+const char* halo_transport = "shm";
+
+typedef struct Ring {
+    _Atomic uint64_t head;  // Rows written
+    char pad1 [64 - sizeof(uint64_t)];
+    _Atomic uint64_t tail;  // Rows read
+    char pad2 [64 - sizeof(uint64_t)];
+} Ring;  // Followed by HALO_SLOTS rows
+
+typedef struct Link {
+    Ring* ring;
+    uint64_t* slots;
+    int fds [2];  // Reading and writing ends of the socket
+} Link;
+
+typedef struct HaloHeader {
+    uint64_t exchange;
+    uint64_t words;
+} HaloHeader;
+
+static int use_sockets;
+static int halo_rows;
+static int row_words;  // Of all the halo rows sent at once
+
+static void wait_turn (int* spins) {
+    if (++*spins > 64) sched_yield();
+}
+
+typedef struct Transfer {
+    int fd;
+    int sending;
+    char* p;
+    size_t left;
+} Transfer;
+
+static void* halo_buffers [4];  // For the socket transfers: two out, two in
+
+ // Moves the transfers along together until they're all done.  Rows can be
+ // bigger than a socket's buffer, so a worker writing its rows out in full
+ // before reading its neighbors' would wait forever on a neighbor doing the
+ // same.
+static void run_transfers (Transfer* t, int n) {
+    for (;;) {
+        struct pollfd fds [4];
+        int which [4];
+        int i, k = 0;
+        for (i = 0; i < n; i++) {
+            if (!t[i].left) continue;
+            fds[k].fd = t[i].fd;
+            fds[k].events = t[i].sending ? POLLOUT : POLLIN;
+            which[k++] = i;
+        }
+        if (!k) return;
+        if (poll(fds, k, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to wait for halo rows: %s\n", strerror(errno));
+            exit(1);
+        }
+        for (i = 0; i < k; i++) {
+            if (!fds[i].revents) continue;
+            Transfer* x = &t[which[i]];
+            ssize_t got = x->sending ? write(x->fd, x->p, x->left) : read(x->fd, x->p, x->left);
+            if (got < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            if (got <= 0) {
+                fprintf(stderr, "Failed to %s a halo row: %s\n", x->sending ? "send" : "receive",
+                    got ? strerror(errno) : "closed"
+                );
+                exit(1);
+            }
+            x->p += got;
+            x->left -= got;
+        }
+    }
+}
+
+ // Sends the rows for exchange e, waiting while the reader is HALO_SLOTS
+ // exchanges behind.
+static void send_row (Link* l, uint64_t e, const uint64_t* row) {
+    int spins = 0;
+    while (e - atomic_load_explicit(&l->ring->tail, memory_order_acquire) >= HALO_SLOTS) wait_turn(&spins);
+    memcpy(&l->slots[(e % HALO_SLOTS) * row_words], row, row_words * sizeof(uint64_t));
+    atomic_store_explicit(&l->ring->head, e + 1, memory_order_release);
+}
+
+static void receive_row (Link* l, uint64_t e, uint64_t* row) {
+    int spins = 0;
+    while (atomic_load_explicit(&l->ring->head, memory_order_acquire) <= e) wait_turn(&spins);
+    memcpy(row, &l->slots[(e % HALO_SLOTS) * row_words], row_words * sizeof(uint64_t));
+    atomic_store_explicit(&l->ring->tail, e + 1, memory_order_release);
+}
+
+ // Sends rows out[k] on links to[k] and receives rows in[k] from links
+ // from[k] for exchange e, skipping NULL links.
+static void exchange_rows (Link** to, uint64_t** out, Link** from, uint64_t** in, uint64_t e) {
+    int k;
+    if (!use_sockets) {
+        for (k = 0; k < 2; k++) {
+            if (to[k]) send_row(to[k], e, out[k]);
+        }
+        for (k = 0; k < 2; k++) {
+            if (from[k]) receive_row(from[k], e, in[k]);
+        }
+        return;
+    }
+    size_t bytes = sizeof(HaloHeader) + row_words * sizeof(uint64_t);
+    Transfer t [4];
+    int n = 0;
+    for (k = 0; k < 4; k++) {
+        if (!halo_buffers[k]) halo_buffers[k] = malloc(bytes);
+    }
+    for (k = 0; k < 2; k++) {
+        if (!to[k]) continue;
+        HaloHeader h = {e, row_words};
+        memcpy(halo_buffers[k], &h, sizeof h);
+        memcpy((char*)halo_buffers[k] + sizeof h, out[k], row_words * sizeof(uint64_t));
+        t[n++] = (Transfer){to[k]->fds[1], 1, halo_buffers[k], bytes};
+    }
+    for (k = 0; k < 2; k++) {
+        if (from[k]) t[n++] = (Transfer){from[k]->fds[0], 0, halo_buffers[2 + k], bytes};
+    }
+    run_transfers(t, n);
+    for (k = 0; k < 2; k++) {
+        if (!from[k]) continue;
+        HaloHeader h;
+        memcpy(&h, halo_buffers[2 + k], sizeof h);
+        if (h.exchange != e || h.words != (uint64_t)row_words) {
+            fprintf(stderr, "Halo rows out of step: got exchange %llu of %llu words, wanted %llu of %d.\n",
+                (unsigned long long)h.exchange, (unsigned long long)h.words, (unsigned long long)e, row_words
+            );
+            exit(1);
+        }
+        memcpy(in[k], (char*)halo_buffers[2 + k] + sizeof h, row_words * sizeof(uint64_t));
+    }
+}
+
+ // Reads a list of CPUs like 0-3,8-11 from a sysfs file into set, returning
+ // how many.
+static int read_cpulist (const char* path, cpu_set_t* set) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    CPU_ZERO(set);
+    int n = 0, lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        if (fscanf(f, "-%d", &hi) < 0) break;
+        for (; lo <= hi && lo < CPU_SETSIZE; lo++, n++) CPU_SET(lo, set);
+        if (fgetc(f) != ',') break;
+    }
+    fclose(f);
+    return n;
+}
+
+ // Pins worker i of n to the CPUs of node i * nodes / n.
+static void pin_worker (int i, int n) {
+    int nodes = 0;
+    char path [128];
+    for (;;) {
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", nodes);
+        if (access(path, R_OK)) break;
+        nodes++;
+    }
+    if (!nodes) return;
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", i * nodes / n);
+    cpu_set_t set;
+    if (read_cpulist(path, &set) && sched_setaffinity(0, sizeof set, &set)) {
+        fprintf(stderr, "Warning: couldn't pin worker %d to %s: %s\n", i, path, strerror(errno));
+    }
+}
+
+static void* map_shared (size_t bytes) {
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %zu bytes of shared memory: %s\n", bytes, strerror(errno));
+        exit(1);
+    }
+    return p;
+}
+
+ // What the workers are told to do next, over their control sockets.
+typedef struct Command {
+    uint64_t gens;
+    int gather;  // Copy the stripe into the shared board afterwards
+    int quit;
+} Command;
+
+ // Reads or writes all n bytes of a message on a control socket, returning
+ // 0 if the other end has gone.
+static int control_io (int fd, void* p, size_t n, int sending) {
+    char* c = p;
+    while (n) {
+        ssize_t got = sending ? send(fd, c, n, MSG_NOSIGNAL) : read(fd, c, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        c += got;
+        n -= got;
+    }
+    return 1;
+}
+
+ // Serves stripe i, rows y0 to y1 of b, stepping it for as many
+ // generations as each command on control asks and writing it into out
+ // when told to gather.  up and down are the links this stripe sends its
+ // top and bottom rows on, from_above and from_below those it receives on,
+ // NULL past an edge that doesn't wrap.
+static void serve_stripe (
+    Board* b, int i, int y0, int y1, int control, uint64_t* out,
+    Link* up, Link* down, Link* from_above, Link* from_below
+) {
+    pin_worker(i, procs);
+     // The worker threads weren't forked with us, and the board the parent
+     // gathers is the one that's sampled and hashed.
+    threads = 1;
+    stats_on = 0;
+    period_on = 0;
+    int h = y1 - y0, d = halo_rows;
+     // An edge with no neighbor is the board's own, dead beyond, so needs no
+     // halo.
+    int lo = from_below ? d : 0;
+    Board* s = board_new(b->width, h + lo + (from_above ? d : 0), b->wrap);
+    size_t words = s->words;
+    memcpy(&s->cells[lo * words], &b->cells[(size_t)y0 * words], (size_t)h * words * sizeof(uint64_t));
+    uint64_t e = 0;
+    Command c;
+    while (control_io(control, &c, sizeof c, 0) && !c.quit) {
+        uint64_t g = 0;
+        while (g < c.gens) {
+            uint64_t* rows = s->cells;
+            Link* to [2] = {up, down};
+            uint64_t* send [2] = {&rows[(lo + h - d) * words], &rows[lo * words]};
+            Link* from [2] = {from_above, from_below};
+            uint64_t* halos [2] = {&rows[(lo + h) * words], rows};
+            exchange_rows(to, send, from, halos, e++);
+             // Errors creep in from the ends of the halos a row a
+             // generation, so d generations leave the stripe itself
+             // untouched.
+            uint64_t k = c.gens - g < (uint64_t)d ? c.gens - g : (uint64_t)d;
+            engine->step(s, k);
+            g += k;
+        }
+        if (c.gather) memcpy(&out[(size_t)y0 * words], &s->cells[lo * words], (size_t)h * words * sizeof(uint64_t));
+        char done = 1;
+        if (!control_io(control, &done, 1, 1)) break;
+    }
+}
+
+ // The workers stay up from the first call of a run to end_stripes, each
+ // keeping its stripe, so a run cut into batches for sampling only pays
+ // for starting them, and for copying the stripes in, once.
+static int nworkers;
+static pid_t* pids;
+static int* controls;  // The parent's ends of the workers' control sockets
+static Link* links;
+static char* rings;
+static size_t ring_bytes;
+static uint64_t* gathered;  // The board, as far as the workers last wrote it
+static size_t board_bytes;
+static Board* stripes_board;  // The board they were started from
+static uint64_t stripes_generation;  // Where it's got to
+static uint64_t stripes_edits;
+static int stale;  // Whether the board's cells are behind the stripes
+
+ // Sends every worker c, then waits for them all to finish it, unless it
+ // was to quit.
+static void command_workers (Command c) {
+    int i, ok = 1;
+    for (i = 0; i < nworkers && ok; i++) ok = control_io(controls[i], &c, sizeof c, 1);
+    for (i = 0; i < nworkers && ok && !c.quit; i++) {
+        char done;
+        ok = control_io(controls[i], &done, 1, 0);
+    }
+    if (!ok) {
+        fprintf(stderr, "A stripe worker failed.\n");
+        exit(1);
+    }
+}
+
+static void stop_workers () {
+    int i, failed = 0;
+    if (!nworkers) return;
+    command_workers((Command){0, 0, 1});
+    for (i = 0; i < nworkers; i++) {
+        int status;
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) failed = 1;
+        close(controls[i]);
+    }
+    if (failed) {
+        fprintf(stderr, "A stripe worker failed.\n");
+        exit(1);
+    }
+    munmap(gathered, board_bytes);
+    if (rings) munmap(rings, 2 * nworkers * ring_bytes);
+    for (i = 0; i < 2 * nworkers && use_sockets; i++) {
+        close(links[i].fds[0]);
+        close(links[i].fds[1]);
+    }
+    free(links);
+    free(pids);
+    free(controls);
+    nworkers = 0;
+    stripes_board = NULL;
+}
+
+static void start_workers (Board* b) {
+    if (rule.states > 2 || rule.radius > 1 || rule.middle) {
+        fprintf(stderr, "-procs only runs Life-like rules, not %s.\n", rule.name);
+        exit(1);
+    }
+    if (engine->step != board_step && engine->step != blocked_step && engine->step != packed_step) {
+        fprintf(stderr, "-procs needs a fixed board, so the %s engine can't be split.\n", engine->name);
+        exit(1);
+    }
+    use_sockets = 0;
+    if (0==strcmp(halo_transport, "socket")) use_sockets = 1;
+    else if (strcmp(halo_transport, "shm")) {
+        fprintf(stderr, "Unknown halo transport: %s\n", halo_transport);
+        exit(1);
+    }
+    int n = procs < b->height ? procs : b->height;
+     // The blocked engine steps as many generations between exchanges as
+     // it does per pass, with as many rows of halo, which no stripe can be
+     // thinner than.
+    halo_rows = 1;
+    if (engine->step == blocked_step) {
+        halo_rows = block_gens < 1 ? 1 : block_gens > 64 ? 64 : block_gens;
+        if (halo_rows > b->height / n) halo_rows = b->height / n;
+    }
+    row_words = halo_rows * b->words;
+     // Link i carries stripe i's top rows up, link n + i its bottom rows down.
+    links = calloc(2 * n, sizeof(Link));
+    ring_bytes = (sizeof(Ring) + HALO_SLOTS * row_words * sizeof(uint64_t) + 63) & ~(size_t)63;
+    rings = use_sockets ? NULL : map_shared(2 * n * ring_bytes);
+    int i, j;
+    for (i = 0; i < 2 * n; i++) {
+        if (use_sockets) {
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, links[i].fds)) {
+                fprintf(stderr, "Failed to make a halo socket: %s\n", strerror(errno));
+                exit(1);
+            }
+            fcntl(links[i].fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(links[i].fds[1], F_SETFL, O_NONBLOCK);
+        }
+        else {
+            links[i].ring = (Ring*)(rings + i * ring_bytes);
+            links[i].slots = (uint64_t*)(links[i].ring + 1);
+        }
+    }
+    board_bytes = (size_t)b->words * b->height * sizeof(uint64_t);
+    gathered = map_shared(board_bytes);
+    pids = malloc(n * sizeof(pid_t));
+    controls = malloc(n * sizeof(int));
+    fflush(NULL);
+    for (i = 0; i < n; i++) {
+        int y0 = (int64_t)b->height * i / n;
+        int y1 = (int64_t)b->height * (i + 1) / n;
+        int above = (i + 1) % n, below = (i + n - 1) % n;
+        int top = i == n - 1, bot = i == 0;
+        int pair [2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+            fprintf(stderr, "Failed to make a control socket: %s\n", strerror(errno));
+            exit(1);
+        }
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            fprintf(stderr, "Failed to start worker %d: %s\n", i, strerror(errno));
+            exit(1);
+        }
+        if (pids[i] == 0) {
+             // Only the parent may hold the other workers' control sockets,
+             // so that each sees the end of the parent's if it goes.
+            for (j = 0; j < i; j++) close(controls[j]);
+            close(pair[0]);
+            serve_stripe(b, i, y0, y1, pair[1], gathered,
+                top && !b->wrap ? NULL : &links[i],
+                bot && !b->wrap ? NULL : &links[n + i],
+                top && !b->wrap ? NULL : &links[n + above],
+                bot && !b->wrap ? NULL : &links[below]
+            );
+            _exit(0);
+        }
+        close(pair[1]);
+        controls[i] = pair[0];
+    }
+    nworkers = n;
+    stripes_board = b;
+    stripes_generation = b->generation;
+    stripes_edits = b->edits;
+    stale = 0;
+}
+
+void run_stripes (Board* b, uint64_t gens, int gather) {
+     // Anything but the board as the workers left it starts them over.
+    if (nworkers && (b != stripes_board || b->generation != stripes_generation || b->edits != stripes_edits)) {
+        stop_workers();
+    }
+    if (!nworkers) start_workers(b);
+    command_workers((Command){gens, gather, 0});
+    if (gather) memcpy(b->cells, gathered, board_bytes);
+    b->generation += gens;
+    stripes_generation = b->generation;
+    stale = !gather;
+}
+
+void end_stripes (Board* b) {
+    if (!nworkers) return;
+    if (stale && b == stripes_board && b->generation == stripes_generation && b->edits == stripes_edits) {
+        command_workers((Command){0, 1, 0});
+        memcpy(b->cells, gathered, board_bytes);
+    }
+    stop_workers();
+}
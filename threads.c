@@ -0,0 +1,162 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "golsh.h"
+
+ // The board is cut into tiles of a strip of columns by a band of rows, each
+ // around TILE_BYTES so that it and its halo rows stay in cache while being
+ // stepped.  Each worker owns a contiguous range of tiles, taking from the
+ // front of its own range and stealing from the back of others' when it runs
+ // out.  A range is packed into one word (tail << 32 | head) so both ends
+ // can be claimed with a single compare-and-swap.
+#define TILE_BYTES 65536
+
+typedef struct Worker {
+    _Atomic uint64_t range;
+    char pad [64 - sizeof(uint64_t)];
+} Worker;
+
+int threads = 1;
+pthread_t* tids;
+Worker* workers;
+pthread_barrier_t go_barrier;
+pthread_barrier_t gen_barrier;
+Board* job_board;
+uint64_t job_gens;
+int tile_rows;
+int tiles_across;
+int tiles_down;
+ // Set instead of stepping for jobs that give each thread an equal band of
+ // rows, like filling the board, where every row costs the same.
+RowJob row_job;
+void* row_arg;
+
+static void deal_tiles () {
+    int n = tiles_across * tiles_down;
+    int i;
+    for (i = 0; i < threads; i++) {
+        uint64_t head = (uint64_t)n * i / threads;
+        uint64_t tail = (uint64_t)n * (i + 1) / threads;
+        atomic_store_explicit(&workers[i].range, tail << 32 | head, memory_order_relaxed);
+    }
+}
+
+static int take_tile (Worker* w, int steal, int* tile) {
+    uint64_t r = atomic_load_explicit(&w->range, memory_order_relaxed);
+    for (;;) {
+        uint32_t head = r;
+        uint32_t tail = r >> 32;
+        if (head >= tail) return 0;
+        uint64_t nr = steal
+            ? (uint64_t)(tail - 1) << 32 | head
+            : (uint64_t)tail << 32 | (head + 1);
+        if (atomic_compare_exchange_weak(&w->range, &r, nr)) {
+            *tile = steal ? tail - 1 : head;
+            return 1;
+        }
+    }
+}
+
+static void run_tile (Board* b, int tile) {
+    int strip = tile % tiles_across;
+    int band = tile / tiles_across;
+    int y0 = band * tile_rows;
+    int y1 = y0 + tile_rows < b->height ? y0 + tile_rows : b->height;
+    int j0 = strip * STEP_BLOCK_WORDS;
+    int j1 = j0 + STEP_BLOCK_WORDS < b->words ? j0 + STEP_BLOCK_WORDS : b->words;
+    step_tile(b, y0, y1, j0, j1);
+}
+
+static void run_job (int self) {
+     // Don't look at the job after the last barrier, since by then the main
+     // thread may have returned and started setting up the next one.
+    Board* b = job_board;
+    uint64_t gens = job_gens;
+    uint64_t g;
+    if (row_job) {
+        RowJob fn = row_job;
+        void* arg = row_arg;
+        fn(b, (int64_t)b->height * self / threads, (int64_t)b->height * (self + 1) / threads, arg);
+        pthread_barrier_wait(&gen_barrier);
+        return;
+    }
+    for (g = 0; g < gens; g++) {
+        int tile, i;
+        while (take_tile(&workers[self], 0, &tile)) {
+            run_tile(b, tile);
+        }
+        for (i = 1; i < threads; i++) {
+            Worker* victim = &workers[(self + i) % threads];
+            while (take_tile(victim, 1, &tile)) {
+                run_tile(b, tile);
+            }
+        }
+        pthread_barrier_wait(&gen_barrier);
+        if (self == 0) {
+            board_swap(b);
+            deal_tiles();
+        }
+        pthread_barrier_wait(&gen_barrier);
+    }
+}
+
+static void* worker_main (void* arg) {
+    int self = (int)(intptr_t)arg;
+    for (;;) {
+        pthread_barrier_wait(&go_barrier);
+        run_job(self);
+    }
+    return NULL;
+}
+
+ // Starts n - 1 worker threads to step alongside the calling thread.  0
+ // means one per online CPU.
+void start_threads (int n) {
+    if (n <= 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    threads = n;
+    if (threads == 1) return;
+    if (posix_memalign((void**)&workers, 64, threads * sizeof(Worker))) {
+        fprintf(stderr, "Out of memory allocating workers.\n");
+        exit(1);
+    }
+    tids = calloc(threads, sizeof(pthread_t));
+    pthread_barrier_init(&go_barrier, NULL, threads);
+    pthread_barrier_init(&gen_barrier, NULL, threads);
+    int i;
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, worker_main, (void*)(intptr_t)i)) {
+            fprintf(stderr, "Failed to start worker thread %d.\n", i);
+            exit(1);
+        }
+    }
+}
+
+void threaded_step (Board* b, uint64_t gens) {
+    tiles_across = (b->words + STEP_BLOCK_WORDS - 1) / STEP_BLOCK_WORDS;
+    int strip = b->words < STEP_BLOCK_WORDS ? b->words : STEP_BLOCK_WORDS;
+    tile_rows = TILE_BYTES / (strip * sizeof(uint64_t));
+    if (tile_rows < 1) tile_rows = 1;
+    tiles_down = (b->height + tile_rows - 1) / tile_rows;
+    job_board = b;
+    job_gens = gens;
+    deal_tiles();
+    pthread_barrier_wait(&go_barrier);
+    run_job(0);
+}
+
+ // Runs fn over the board's rows, split evenly across the threads.
+void threaded_rows (Board* b, RowJob fn, void* arg) {
+    if (threads == 1) {
+        fn(b, 0, b->height, arg);
+        return;
+    }
+    job_board = b;
+    row_job = fn;
+    row_arg = arg;
+    pthread_barrier_wait(&go_barrier);
+    run_job(0);
+    row_job = NULL;
+}